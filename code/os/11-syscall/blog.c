@@ -0,0 +1,132 @@
+#include "os.h"
+
+/*
+ * Binary log with deferred formatting.
+ *
+ * blog() doesn't format anything, it just records the address of the format
+ * string (which is in .rodata of os.elf, so it identifies the message), the
+ * lower 32 bits of mtime and the raw arguments in a ring buffer of the
+ * calling hart. This takes tens of cycles instead of formatting and sending
+ * the text in the interrupt path.
+ *
+ * The rings are drained lazily by a work item, which is queued from the
+ * timer interrupt, and each record is sent over the UART as a line of hex
+ * words:
+ * 	@L <hart> <format address> <mtime> <arg0> <arg1> ...
+ * tools/blogdec.py turns these lines back into text with the format strings
+ * taken from os.elf.
+ *
+ * A ring may have many writers (tasks in user mode, interrupt handlers), so
+ * a writer reserves the words of its record by increasing head atomically,
+ * fills them, and writes the header word last with BLOG_COMMITTED set. The
+ * reader stops at a header which is not committed yet, and zeroes every word
+ * it has consumed, so that a header is never mistaken for committed.
+ * When a ring is full, the record is dropped and counted.
+ */
+#define BLOG_RING_WORDS 1024
+#define BLOG_MAX_ARGS 6
+
+/* header word: BLOG_COMMITTED | number of words of the record */
+#define BLOG_COMMITTED (1 << 31)
+#define BLOG_LEN_MASK 0xff
+
+struct blog_ring {
+	volatile reg_t buf[BLOG_RING_WORDS];
+	volatile uint32_t head;
+	volatile uint32_t tail;
+	volatile uint32_t dropped;
+};
+
+static struct blog_ring blog_rings[MAXNUM_CPU];
+static struct work blog_work;
+
+void blog_write(const char *fmt, const reg_t *args, int nargs)
+{
+	/* tp holds the hartid, and can be read in user mode */
+	struct blog_ring *ring = &blog_rings[r_tp()];
+
+	if (nargs > BLOG_MAX_ARGS) {
+		nargs = BLOG_MAX_ARGS;
+	}
+	uint32_t len = 3 + nargs;
+
+	uint32_t head = ring->head;
+	do {
+		if (head + len - ring->tail > BLOG_RING_WORDS) {
+			__atomic_fetch_add(&ring->dropped, 1, __ATOMIC_RELAXED);
+			return;
+		}
+	} while (!__atomic_compare_exchange_n(&ring->head, &head, head + len, 0,
+					      __ATOMIC_ACQ_REL, __ATOMIC_RELAXED));
+
+	ring->buf[(head + 1) % BLOG_RING_WORDS] = (reg_t)fmt;
+	ring->buf[(head + 2) % BLOG_RING_WORDS] = *(volatile uint32_t *)CLINT_MTIME;
+	for (int i = 0; i < nargs; i++) {
+		ring->buf[(head + 3 + i) % BLOG_RING_WORDS] = args[i];
+	}
+	__atomic_store_n(&ring->buf[head % BLOG_RING_WORDS],
+			 BLOG_COMMITTED | len, __ATOMIC_RELEASE);
+}
+
+static void blog_drain(void *arg)
+{
+	for (int hart = 0; hart < MAXNUM_CPU; hart++) {
+		struct blog_ring *ring = &blog_rings[hart];
+
+		while (ring->tail != ring->head) {
+			uint32_t tail = ring->tail;
+			reg_t header = __atomic_load_n(&ring->buf[tail % BLOG_RING_WORDS],
+						       __ATOMIC_ACQUIRE);
+			if (!(header & BLOG_COMMITTED)) {
+				break;
+			}
+
+			uint32_t len = header & BLOG_LEN_MASK;
+			printf("@L %d", hart);
+			for (uint32_t i = 1; i < len; i++) {
+				printf(" %x", ring->buf[(tail + i) % BLOG_RING_WORDS]);
+			}
+			printf("\n");
+
+			for (uint32_t i = 0; i < len; i++) {
+				ring->buf[(tail + i) % BLOG_RING_WORDS] = 0;
+			}
+			ring->tail = tail + len;
+		}
+
+		uint32_t dropped = __atomic_exchange_n(&ring->dropped, 0, __ATOMIC_RELAXED);
+		if (dropped) {
+			printf("blog: hart %d dropped %d records\n", hart, dropped);
+		}
+	}
+}
+
+/*
+ * DESCRIPTION
+ * 	Drain the rings at once, for panic(), which never returns to run the
+ * 	work.
+ */
+void blog_flush(void)
+{
+	blog_drain(NULL);
+}
+
+void blog_init(void)
+{
+	work_init(&blog_work, blog_drain, NULL);
+}
+
+/*
+ * DESCRIPTION
+ * 	Queue the work to drain the rings if anything has been logged.
+ * 	Called from the timer interrupt.
+ */
+void blog_kick(void)
+{
+	for (int hart = 0; hart < MAXNUM_CPU; hart++) {
+		if (blog_rings[hart].tail != blog_rings[hart].head) {
+			queue_work(&blog_work);
+			return;
+		}
+	}
+}
@@ -0,0 +1,67 @@
+#include "os.h"
+
+/*
+ * Futexes, the slow path of the user-space locks, see mutex.c.
+ *
+ * A lock is an int in user memory, taken and released by atomic
+ * instructions without a trap when it is not contended. Only a task which
+ * has to wait for the lock calls futex_wait(), and only the owner which
+ * sees waiters calls futex_wake().
+ *
+ * Each waiting task blocks on its own wait queue, and futex_addr tells
+ * which int it waits on. The system calls run with interrupt disabled on
+ * the only hart which runs the tasks, so the check of the value in
+ * futex_wait() can't race with the owner releasing the lock.
+ */
+static struct wait_queue waiters[MAX_TASKS];
+static int *futex_addr[MAX_TASKS];
+
+/*
+ * DESCRIPTION
+ * 	Block the calling task if *addr still holds val, till futex_wake() is
+ * 	called on addr.
+ * RETURN VALUE
+ * 	0: woken up by futex_wake()
+ * 	-1: if *addr doesn't hold val, the caller should check it again, or
+ * 	    error occured
+ */
+int sys_futex_wait(int *addr, int val)
+{
+	int id = task_current();
+
+	if (addr == NULL || ((reg_t)addr & 3)) {
+		return -1;
+	}
+	if (*addr != val) {
+		return -1;
+	}
+
+	futex_addr[id] = addr;
+	syscall_block(&waiters[id], 0);
+	return 0;
+}
+
+/*
+ * DESCRIPTION
+ * 	Wake up at most n tasks waiting on addr, in the order of task ids.
+ * RETURN VALUE
+ * 	the number of tasks woken up
+ * 	-1: if error occured
+ */
+int sys_futex_wake(int *addr, int n)
+{
+	int woken = 0;
+
+	if (addr == NULL || n < 0) {
+		return -1;
+	}
+
+	for (int i = 0; i < MAX_TASKS && woken < n; i++) {
+		if (futex_addr[i] == addr) {
+			futex_addr[i] = NULL;
+			wake_up(&waiters[i]);
+			woken++;
+		}
+	}
+	return woken;
+}
@@ -0,0 +1,159 @@
+#include "os.h"
+
+/*
+ * Synchronous IPC in registers, in the style of L4.
+ *
+ * A client calls a server with a message of IPC_WORDS words in a0 ~ a5,
+ * and blocks till the server replies with another message in a0 ~ a5. The
+ * server replies to its last client and waits for the next call in one
+ * system call, ipc_reply_wait(). The words are copied from the saved
+ * context of one task to that of the other, and never touch memory of the
+ * tasks.
+ *
+ * When the other side is already waiting, the kernel switches straight to
+ * it by schedule_to(), without the round-robin scan of schedule(): the
+ * client to the server waiting for a call, and the server to the client it
+ * replied to if no other call is pending. A call to a server which is busy
+ * waits till the server gets to it.
+ *
+ * So the system calls, ipc_call_regs and ipc_reply_wait_regs, don't take
+ * their arguments the usual way. The peer is in a6: the server to call, or
+ * the client to reply to, -1 for none. On return a6 holds 0 for a call,
+ * the client of the new call for a reply_wait, or -1 if error occured. The
+ * user calls them by ipc_call() and ipc_reply_wait() in usys.S, which load
+ * and store the words from a struct ipc_msg.
+ */
+#define IPC_WORDS 6
+
+#define IPC_IDLE  0
+#define IPC_RECV  1	/* a server waiting for a call */
+#define IPC_SEND  2	/* a client waiting for the server to take its call */
+#define IPC_REPLY 3	/* a client waiting for the reply */
+
+static uint8_t ipc_state[MAX_TASKS];
+static int ipc_peer[MAX_TASKS];		/* the server of a client */
+static struct wait_queue ipc_wait[MAX_TASKS];
+
+static void ipc_copy(struct context *dst, struct context *src)
+{
+	reg_t *d = &dst->a0;
+	reg_t *s = &src->a0;
+	for (int i = 0; i < IPC_WORDS; i++) {
+		d[i] = s[i];
+	}
+}
+
+/* hand the call of a client to the server, and leave it waiting for reply */
+static void ipc_take(int server, int client)
+{
+	struct context *s = task_context(server);
+
+	ipc_copy(s, task_context(client));
+	s->a6 = client;
+	ipc_state[server] = IPC_IDLE;
+	ipc_state[client] = IPC_REPLY;
+	ipc_peer[client] = server;
+}
+
+/* the return value which leaves a0 as it is, for the errors */
+static reg_t ipc_error(struct context *cxt)
+{
+	cxt->a6 = -1;
+	return cxt->a0;
+}
+
+/*
+ * DESCRIPTION
+ * 	Call the server in a6 with the message in a0 ~ a5, and block till its
+ * 	reply is in a0 ~ a5.
+ */
+reg_t sys_ipc_call_regs(void)
+{
+	int id = task_current();
+	struct context *cxt = task_context(id);
+	int server = cxt->a6;
+
+	if (server == id || task_context(server) == NULL) {
+		return ipc_error(cxt);
+	}
+
+	/* the pc of the client stays at the ecall till the reply */
+	wait_queue_sleep(&ipc_wait[id]);
+
+	if (ipc_state[server] == IPC_RECV) {
+		/* the fast path, the server is waiting for us */
+		ipc_take(server, id);
+		task_context(server)->pc += 4;
+		wake_up(&ipc_wait[server]);
+		schedule_to(server);
+	}
+
+	ipc_state[id] = IPC_SEND;
+	ipc_peer[id] = server;
+	schedule();
+	return 0;
+}
+
+/*
+ * DESCRIPTION
+ * 	Reply to the client in a6 with the message in a0 ~ a5 unless a6 is
+ * 	-1, then wait for a call, which is returned in a0 ~ a5 and its client
+ * 	in a6.
+ */
+reg_t sys_ipc_reply_wait_regs(void)
+{
+	int id = task_current();
+	struct context *cxt = task_context(id);
+	int client = cxt->a6;
+
+	if (client != -1) {
+		struct context *c = task_context(client);
+		if (c == NULL || ipc_state[client] != IPC_REPLY ||
+		    ipc_peer[client] != id) {
+			return ipc_error(cxt);
+		}
+		ipc_copy(c, cxt);
+		c->a6 = 0;
+		c->pc += 4;
+		ipc_state[client] = IPC_IDLE;
+		wake_up(&ipc_wait[client]);
+	}
+
+	/* take a pending call at once, returning the usual way */
+	for (int i = 0; i < MAX_TASKS; i++) {
+		if (ipc_state[i] == IPC_SEND && ipc_peer[i] == id &&
+		    task_context(i)) {
+			ipc_take(id, i);
+			return cxt->a0;
+		}
+	}
+
+	ipc_state[id] = IPC_RECV;
+	wait_queue_sleep(&ipc_wait[id]);
+	if (client != -1) {
+		/* the fast path back to the client */
+		schedule_to(client);
+	}
+	schedule();
+	return 0;
+}
+
+/*
+ * DESCRIPTION
+ * 	Fail the calls pending on an exiting server, the clients return -1
+ * 	in a6. Must be called with interrupt disabled, e.g. in a system call.
+ */
+void ipc_exit(int task)
+{
+	for (int i = 0; i < MAX_TASKS; i++) {
+		if ((ipc_state[i] == IPC_SEND || ipc_state[i] == IPC_REPLY) &&
+		    ipc_peer[i] == task && task_context(i)) {
+			struct context *c = task_context(i);
+			c->a6 = -1;
+			c->pc += 4;
+			ipc_state[i] = IPC_IDLE;
+			wake_up(&ipc_wait[i]);
+		}
+	}
+	ipc_state[task] = IPC_IDLE;
+}
@@ -0,0 +1,264 @@
+#include "os.h"
+
+/*
+ * Interrupt descriptor of each PLIC interrupt source, indexed by the IRQ
+ * number so that dispatching is just a table lookup.
+ * - handler/arg: registered by request_irq()
+ * - affinity: bitmask of the harts which the source is delivered to
+ * - count: number of times the handler has been called
+ * - total_cycles/max_cycles: cycles spent in the handler
+ * - balanced_cycles: total_cycles when irq_balance() ran last time
+ */
+struct irq_desc {
+	void (*handler)(void *arg);
+	void *arg;
+	uint32_t affinity;
+	uint32_t count;
+	uint64_t total_cycles;
+	uint32_t max_cycles;
+	uint64_t balanced_cycles;
+};
+
+/* source 0 is reserved by PLIC, so valid IRQ numbers are 1 ~ PLIC_NUM_SOURCES */
+static struct irq_desc irq_table[PLIC_NUM_SOURCES + 1];
+
+/*
+ * _online_harts: bitmask of the harts which have called plic_init() and can
+ * serve external interrupts.
+ * _hart_cycles: cycles spent by each hart in interrupt handlers since
+ * irq_balance() ran last time.
+ */
+static uint32_t _online_harts = 0;
+static uint32_t _hart_cycles[MAXNUM_CPU];
+
+static inline int irq_valid(int irq)
+{
+	return (irq > 0 && irq <= PLIC_NUM_SOURCES);
+}
+
+/* program the enable bit of irq for all the harts according to hart_mask */
+static void irq_program_affinity(int irq, uint32_t hart_mask)
+{
+	for (int hart = 0; hart < MAXNUM_CPU; hart++) {
+		if (hart_mask & (1 << hart)) {
+			plic_enable(hart, irq);
+		} else {
+			plic_disable(hart, irq);
+		}
+	}
+}
+
+/*
+ * DESCRIPTION
+ * 	Called by plic_init() on each hart once it is ready to serve
+ * 	external interrupts.
+ */
+void irq_hart_online(int hart)
+{
+	_online_harts |= (1 << hart);
+}
+
+/*
+ * DESCRIPTION
+ * 	Register a handler for an external interrupt source and enable it.
+ * 	The source is delivered to the calling hart until irq_set_affinity()
+ * 	or irq_balance() moves it.
+ * 	- irq: PLIC interrupt source ID, 1 ~ PLIC_NUM_SOURCES
+ * 	- handler: called in interrupt context with arg
+ * 	- priority: PLIC priority, 1 (lowest) ~ PLIC_NUM_PRIORITIES (highest)
+ * 	Should be called in kernel (machine mode) with interrupt disabled,
+ * 	e.g. during the initialization of the driver.
+ * RETURN VALUE
+ * 	0: success
+ * 	-1: if error occured, e.g. the irq has been registered already
+ */
+int request_irq(int irq, void (*handler)(void *arg), void *arg, int priority)
+{
+	if (!irq_valid(irq) || NULL == handler) {
+		return -1;
+	}
+	if (priority <= 0 || priority > PLIC_NUM_PRIORITIES) {
+		return -1;
+	}
+
+	struct irq_desc *desc = &irq_table[irq];
+	if (NULL != desc->handler) {
+		return -1;
+	}
+	desc->handler = handler;
+	desc->arg = arg;
+	desc->affinity = (1 << r_tp());
+	desc->count = 0;
+	desc->total_cycles = 0;
+	desc->max_cycles = 0;
+	desc->balanced_cycles = 0;
+
+	plic_set_priority(irq, priority);
+	irq_program_affinity(irq, desc->affinity);
+
+	return 0;
+}
+
+/*
+ * DESCRIPTION
+ * 	Disable the interrupt source and unregister its handler.
+ */
+void free_irq(int irq)
+{
+	if (!irq_valid(irq)) {
+		return;
+	}
+
+	irq_program_affinity(irq, 0);
+	plic_set_priority(irq, 0);
+
+	irq_table[irq].handler = NULL;
+	irq_table[irq].arg = NULL;
+	irq_table[irq].affinity = 0;
+}
+
+/*
+ * DESCRIPTION
+ * 	Route a registered interrupt source to the harts in hart_mask, by
+ * 	programming the enable bits of each hart's M-mode PLIC context.
+ * 	Harts which are not online are ignored.
+ * RETURN VALUE
+ * 	0: success
+ * 	-1: if the irq is not registered or no online hart is in hart_mask
+ */
+int irq_set_affinity(int irq, uint32_t hart_mask)
+{
+	if (!irq_valid(irq) || NULL == irq_table[irq].handler) {
+		return -1;
+	}
+
+	hart_mask &= _online_harts;
+	if (0 == hart_mask) {
+		return -1;
+	}
+
+	irq_table[irq].affinity = hart_mask;
+	irq_program_affinity(irq, hart_mask);
+
+	return 0;
+}
+
+uint32_t irq_get_affinity(int irq)
+{
+	if (!irq_valid(irq)) {
+		return 0;
+	}
+	return irq_table[irq].affinity;
+}
+
+/*
+ * DESCRIPTION
+ * 	Call the handler registered for irq and account the time spent.
+ * 	This routine should be called in interrupt context (interrupt is
+ * 	disabled).
+ */
+void irq_dispatch(int irq)
+{
+	if (!irq_valid(irq) || NULL == irq_table[irq].handler) {
+		pr_warn(IRQ, "unexpected interrupt irq = %d\n", irq);
+		return;
+	}
+
+	struct irq_desc *desc = &irq_table[irq];
+	reg_t start = r_cycle();
+
+	desc->handler(desc->arg);
+
+	/* unsigned subtraction is still right if the 32-bit counter wraps */
+	reg_t cycles = r_cycle() - start;
+	desc->count++;
+	desc->total_cycles += cycles;
+	if (cycles > desc->max_cycles) {
+		desc->max_cycles = cycles;
+	}
+	_hart_cycles[r_tp()] += cycles;
+}
+
+/*
+ * DESCRIPTION
+ * 	Move the busiest interrupt source of the most loaded hart to the
+ * 	least loaded hart, if that makes the load more even. The load is the
+ * 	cycles spent in interrupt handlers since the last call, so this is
+ * 	expected to be called periodically, e.g. from the timer interrupt.
+ * 	Only the sources bound to a single hart are moved, the ones with a
+ * 	wider affinity set by irq_set_affinity() are left as they are.
+ * 	This routine should be called in interrupt context (interrupt is
+ * 	disabled).
+ */
+void irq_balance(void)
+{
+	int busiest = -1;
+	int idlest = -1;
+	for (int hart = 0; hart < MAXNUM_CPU; hart++) {
+		if (!(_online_harts & (1 << hart))) {
+			continue;
+		}
+		if (busiest == -1 || _hart_cycles[hart] > _hart_cycles[busiest]) {
+			busiest = hart;
+		}
+		if (idlest == -1 || _hart_cycles[hart] < _hart_cycles[idlest]) {
+			idlest = hart;
+		}
+	}
+
+	/* pick the source which brings both harts closest to each other */
+	int candidate = 0;
+	if (busiest != idlest) {
+		uint32_t gap = _hart_cycles[busiest] - _hart_cycles[idlest];
+		uint32_t best = 0;
+		for (int irq = 1; irq <= PLIC_NUM_SOURCES; irq++) {
+			struct irq_desc *desc = &irq_table[irq];
+			if (NULL == desc->handler || desc->affinity != (1 << busiest)) {
+				continue;
+			}
+			uint32_t load = desc->total_cycles - desc->balanced_cycles;
+			if (load < gap && load > best) {
+				best = load;
+				candidate = irq;
+			}
+		}
+	}
+	if (candidate) {
+		irq_set_affinity(candidate, 1 << idlest);
+	}
+
+	/* start a new period */
+	for (int irq = 1; irq <= PLIC_NUM_SOURCES; irq++) {
+		irq_table[irq].balanced_cycles = irq_table[irq].total_cycles;
+	}
+	for (int hart = 0; hart < MAXNUM_CPU; hart++) {
+		_hart_cycles[hart] = 0;
+	}
+}
+
+/* number of times the handler of irq has been called */
+uint32_t irq_get_count(int irq)
+{
+	if (!irq_valid(irq)) {
+		return 0;
+	}
+	return irq_table[irq].count;
+}
+
+/*
+ * DESCRIPTION
+ * 	Print the statistics of all the interrupt sources which have been
+ * 	registered or have been served.
+ */
+void irq_show_stats(void)
+{
+	printf("IRQ AFFINITY      COUNT        TOTAL(cycles)  MAX(cycles)\n");
+	for (int irq = 1; irq <= PLIC_NUM_SOURCES; irq++) {
+		struct irq_desc *desc = &irq_table[irq];
+		if (NULL == desc->handler && 0 == desc->count) {
+			continue;
+		}
+		printf("%3d 0x%08x %10u %20llu %12u\n", irq, desc->affinity,
+		       desc->count, desc->total_cycles, desc->max_cycles);
+	}
+}
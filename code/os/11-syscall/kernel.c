@@ -12,9 +12,19 @@ extern void os_main(void);
 extern void trap_init(void);
 extern void plic_init(void);
 extern void timer_init(void);
+extern void workqueue_init(void);
+extern void blog_init(void);
+extern void perf_init(void);
+extern void vdso_init(void);
 
 void start_kernel(void)
 {
+	/*
+	 * plic_init() must be called before any driver, e.g. uart, which
+	 * registers its interrupt handler by request_irq().
+	 */
+	plic_init();
+
 	uart_init();
 	uart_puts("Hello, RVOS!\n");
 
@@ -22,12 +32,20 @@ void start_kernel(void)
 
 	trap_init();
 
-	plic_init();
+	vdso_init();
 
 	timer_init();
 
 	sched_init();
 
+	workqueue_init();
+
+	blog_init();
+
+#ifdef CONFIG_PERF
+	perf_init();
+#endif
+
 	os_main();
 
 	schedule();
@@ -0,0 +1,35 @@
+#include "os.h"
+
+/*
+ * DESCRIPTION
+ * 	64-bit unsigned division. It is done by libgcc on RV32, which we
+ * 	don't link, so divide by shift and subtract, or with the 32-bit
+ * 	divider when both fit in 32 bits.
+ * 	- rem: returns the remainder, or NULL
+ * RETURN VALUE
+ * 	n / d, 0 if d is 0
+ */
+uint64_t udiv64(uint64_t n, uint64_t d, uint64_t *rem)
+{
+	uint64_t q = 0, r = 0;
+
+	if (d == 0) {
+		r = n;
+	} else if (!(n >> 32) && !(d >> 32)) {
+		q = (uint32_t)n / (uint32_t)d;
+		r = (uint32_t)n % (uint32_t)d;
+	} else {
+		for (int i = 63; i >= 0; i--) {
+			r = (r << 1) | ((n >> i) & 1);
+			if (r >= d) {
+				r -= d;
+				q |= (uint64_t)1 << i;
+			}
+		}
+	}
+
+	if (rem) {
+		*rem = r;
+	}
+	return q;
+}
@@ -11,3 +11,22 @@ int spin_unlock()
 	w_mstatus(r_mstatus() | MSTATUS_MIE);
 	return 0;
 }
+
+/*
+ * Disable interrupts and return the previous mstatus, which should be
+ * passed to local_irq_restore(). Unlike spin_unlock(), the pair keeps
+ * interrupts disabled if they were, so it is safe in interrupt context.
+ */
+reg_t local_irq_save()
+{
+	reg_t flags = r_mstatus();
+	w_mstatus(flags & ~MSTATUS_MIE);
+	return flags;
+}
+
+void local_irq_restore(reg_t flags)
+{
+	if (flags & MSTATUS_MIE) {
+		w_mstatus(r_mstatus() | MSTATUS_MIE);
+	}
+}
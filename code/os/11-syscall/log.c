@@ -0,0 +1,28 @@
+#include "os.h"
+
+/* runtime log levels, everything compiled in is output by default */
+uint8_t log_level[LOG_NR_SUBSYS] = {
+	[LOG_TRAP] = LOG_DEBUG,
+	[LOG_SYSCALL] = LOG_DEBUG,
+	[LOG_TIMER] = LOG_DEBUG,
+	[LOG_IRQ] = LOG_DEBUG,
+	[LOG_SCHED] = LOG_DEBUG,
+};
+
+/*
+ * DESCRIPTION
+ * 	Change the runtime log level of a subsystem. Raising it above the
+ * 	compile-time level has no effect since those messages are compiled out.
+ * RETURN VALUE
+ * 	0: success
+ * 	-1: if error occured
+ */
+int log_set_level(int subsys, int level)
+{
+	if (subsys < 0 || subsys >= LOG_NR_SUBSYS ||
+	    level < LOG_NONE || level > LOG_DEBUG) {
+		return -1;
+	}
+	log_level[subsys] = level;
+	return 0;
+}
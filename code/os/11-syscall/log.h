@@ -0,0 +1,70 @@
+#ifndef __LOG_H__
+#define __LOG_H__
+
+#include "types.h"
+
+/*
+ * Kernel log with per-subsystem levels.
+ *
+ * A message is only output if its level is not above both:
+ * - the compile-time level of the subsystem, LOG_LEVEL_<SUBSYS>, which
+ *   defaults to LOG_LEVEL (see Makefile). A message above it is compiled
+ *   out together with its arguments, so it costs nothing.
+ * - the runtime level of the subsystem, log_level[LOG_<SUBSYS>], which can
+ *   be changed by log_set_level() to silence a subsystem without rebuilding.
+ *
+ * e.g. pr_debug(TRAP, "Sync exceptions!, code = %d\n", cause_code);
+ * The messages are output by blog(), so the same rules for the arguments
+ * apply, see os.h.
+ */
+#define LOG_NONE	0
+#define LOG_ERR		1
+#define LOG_WARN	2
+#define LOG_INFO	3
+#define LOG_DEBUG	4
+
+#ifndef LOG_LEVEL
+#define LOG_LEVEL LOG_WARN
+#endif
+
+/* subsystems */
+#define LOG_TRAP	0
+#define LOG_SYSCALL	1
+#define LOG_TIMER	2
+#define LOG_IRQ		3
+#define LOG_SCHED	4
+#define LOG_NR_SUBSYS	5
+
+#ifndef LOG_LEVEL_TRAP
+#define LOG_LEVEL_TRAP LOG_LEVEL
+#endif
+#ifndef LOG_LEVEL_SYSCALL
+#define LOG_LEVEL_SYSCALL LOG_LEVEL
+#endif
+#ifndef LOG_LEVEL_TIMER
+#define LOG_LEVEL_TIMER LOG_LEVEL
+#endif
+#ifndef LOG_LEVEL_IRQ
+#define LOG_LEVEL_IRQ LOG_LEVEL
+#endif
+#ifndef LOG_LEVEL_SCHED
+#define LOG_LEVEL_SCHED LOG_LEVEL
+#endif
+
+extern uint8_t log_level[LOG_NR_SUBSYS];
+extern int log_set_level(int subsys, int level);
+
+#define pr_log(subsys, level, fmt, ...) \
+	do { \
+		if ((level) <= LOG_LEVEL_##subsys && \
+		    (level) <= log_level[LOG_##subsys]) { \
+			blog("[" #subsys "] " fmt, ##__VA_ARGS__); \
+		} \
+	} while (0)
+
+#define pr_err(subsys, fmt, ...)   pr_log(subsys, LOG_ERR, fmt, ##__VA_ARGS__)
+#define pr_warn(subsys, fmt, ...)  pr_log(subsys, LOG_WARN, fmt, ##__VA_ARGS__)
+#define pr_info(subsys, fmt, ...)  pr_log(subsys, LOG_INFO, fmt, ##__VA_ARGS__)
+#define pr_debug(subsys, fmt, ...) pr_log(subsys, LOG_DEBUG, fmt, ##__VA_ARGS__)
+
+#endif /* __LOG_H__ */
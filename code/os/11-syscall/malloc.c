@@ -0,0 +1,124 @@
+#include "os.h"
+
+/*
+ * A first-fit allocator for the blocks smaller than a page, on top of
+ * page_alloc().
+ *
+ * Each block starts with a header holding its size, the header included.
+ * The free blocks are kept in a list sorted by address, so a block freed
+ * is merged with its free neighbours. When no free block is large enough,
+ * more pages are taken by page_alloc(), they are never given back.
+ */
+#define PAGE_SIZE 4096
+
+struct block {
+	uint32_t size;
+	struct block *next;	/* the next free block, for free blocks only */
+};
+
+/* the header, also the alignment of the blocks */
+#define BLOCK_HDR sizeof(struct block)
+#define BLOCK_MIN (BLOCK_HDR * 2)
+
+static struct block *free_list = NULL;
+
+/* insert a block to the free list, and merge it with its neighbours */
+static void block_insert(struct block *b)
+{
+	struct block *prev = NULL;
+	struct block *cur = free_list;
+	while (cur && cur < b) {
+		prev = cur;
+		cur = cur->next;
+	}
+
+	b->next = cur;
+	if (cur && (uint8_t *)b + b->size == (uint8_t *)cur) {
+		b->size += cur->size;
+		b->next = cur->next;
+	}
+
+	if (prev == NULL) {
+		free_list = b;
+	} else if ((uint8_t *)prev + prev->size == (uint8_t *)b) {
+		prev->size += b->size;
+		prev->next = b->next;
+	} else {
+		prev->next = b;
+	}
+}
+
+/*
+ * DESCRIPTION
+ * 	Allocate a memory block for the kernel and the user tasks.
+ * 	- size: the number of bytes to allocate
+ * RETURN VALUE
+ * 	the start address of the memory block, which is 8-byte aligned
+ * 	NULL: if error occured
+ */
+void *kmalloc(size_t size)
+{
+	/* the size comes from the user tasks, don't let the rounding wrap */
+	if (size == 0 || size > HEAP_SIZE) {
+		return NULL;
+	}
+	size = (size + BLOCK_HDR - 1) / BLOCK_HDR * BLOCK_HDR + BLOCK_HDR;
+
+	reg_t flags = local_irq_save();
+
+	struct block *b = NULL;
+	while (b == NULL) {
+		struct block *prev = NULL;
+		struct block *cur = free_list;
+		while (cur && cur->size < size) {
+			prev = cur;
+			cur = cur->next;
+		}
+
+		if (cur == NULL) {
+			/* no free block is large enough, take more pages */
+			int npages = (size + PAGE_SIZE - 1) / PAGE_SIZE;
+			struct block *p = page_alloc(npages);
+			if (p == NULL) {
+				break;
+			}
+			p->size = npages * PAGE_SIZE;
+			block_insert(p);
+			continue;
+		}
+
+		if (cur->size - size >= BLOCK_MIN) {
+			/* split it, and take the tail */
+			cur->size -= size;
+			b = (struct block *)((uint8_t *)cur + cur->size);
+			b->size = size;
+		} else {
+			if (prev == NULL) {
+				free_list = cur->next;
+			} else {
+				prev->next = cur->next;
+			}
+			b = cur;
+		}
+	}
+
+	local_irq_restore(flags);
+
+	return b ? (uint8_t *)b + BLOCK_HDR : NULL;
+}
+
+/*
+ * DESCRIPTION
+ * 	Free a memory block allocated by kmalloc().
+ * 	- ptr: start address of the memory block, or NULL
+ */
+void kfree(void *ptr)
+{
+	if (ptr == NULL) {
+		return;
+	}
+
+	reg_t flags = local_irq_save();
+	block_insert((struct block *)((uint8_t *)ptr - BLOCK_HDR));
+	local_irq_restore(flags);
+}
@@ -0,0 +1,289 @@
+#include "os.h"
+
+/*
+ * Message queues.
+ *
+ * A queue holds up to depth messages of msg_size bytes, in a pool of depth
+ * buffers from kmalloc(). A message is queued as the pointer to its buffer,
+ * so there are two ways to use a queue:
+ * - copying: mq_send() copies the message into a free buffer, and
+ *   mq_receive() copies it out and frees the buffer;
+ * - zero-copy: the sender takes a buffer by mq_alloc(), fills it and sends
+ *   it by mq_send(), which doesn't copy a buffer of the pool. The receiver
+ *   gets the buffer itself by mq_receive() with no buf, and gives it back by
+ *   mq_free() when done with it.
+ * A sender blocks while no buffer is free, and a receiver blocks while no
+ * message is queued. Both wait with syscall_wait(), so the system call is
+ * run again and checks the queue again when the task wakes up.
+ *
+ * Like the shm handles, a handle carries a generation number, so a stale
+ * handle of a destroyed queue doesn't reach the queue which reuses its
+ * slot. It wraps so the handles fit in WAIT_ID_MASK for wait_any().
+ */
+#define MQ_MAX 8
+#define MQ_MAX_DEPTH 32
+#define MQ_MAX_MSG_SIZE 4096
+#define MQ_GEN_MAX ((WAIT_ID_MASK + 1) / MQ_MAX)
+#define MQ_SLOT(handle) ((handle) % MQ_MAX)
+#define MQ_GEN(handle) ((handle) / MQ_MAX)
+
+struct mq {
+	uint8_t *pool;		/* depth buffers of stride, NULL if unused */
+	uint32_t depth;
+	uint32_t msg_size;	/* as asked for, the size of the copies */
+	uint32_t stride;	/* msg_size rounded up to a word */
+	uint32_t free;		/* a bit for each free buffer */
+	uint32_t queued;	/* a bit for each buffer in the ring */
+	uint32_t head;		/* ring of the queued buffers */
+	uint32_t tail;
+	uint8_t *ring[MQ_MAX_DEPTH];
+	struct wait_queue senders;
+	struct wait_queue receivers;
+	uint32_t gen;
+};
+
+static struct mq mqs[MQ_MAX];
+
+static struct mq *mq_get(int handle)
+{
+	if (handle < 0) {
+		return NULL;
+	}
+	struct mq *q = &mqs[MQ_SLOT(handle)];
+	if (q->pool == NULL || q->gen != MQ_GEN(handle)) {
+		return NULL;
+	}
+	return q;
+}
+
+/* the index of the buffer in the pool, or -1 if it isn't one */
+static int mq_buf_index(struct mq *q, void *buf)
+{
+	uint8_t *p = (uint8_t *)buf;
+	if (p < q->pool || p >= q->pool + q->depth * q->stride) {
+		return -1;
+	}
+	if ((p - q->pool) % q->stride) {
+		return -1;
+	}
+	return (p - q->pool) / q->stride;
+}
+
+/* take a free buffer, or block till there is one */
+static uint8_t *mq_buf_alloc(struct mq *q)
+{
+	if (q->free == 0) {
+		syscall_wait(&q->senders);
+	}
+	int i = 0;
+	while (!(q->free & (1 << i))) {
+		i++;
+	}
+	q->free &= ~(1 << i);
+	return q->pool + i * q->stride;
+}
+
+static void mq_copy(uint8_t *dst, uint8_t *src, uint32_t n)
+{
+	while (n--) {
+		*dst++ = *src++;
+	}
+}
+
+static void mq_buf_free(struct mq *q, int i)
+{
+	q->free |= 1 << i;
+	wake_up(&q->senders);
+}
+
+/*
+ * DESCRIPTION
+ * 	Create a message queue.
+ * 	- depth: the max number of messages, 1 ~ MQ_MAX_DEPTH
+ * 	- msg_size: the size of each message in bytes, 1 ~ MQ_MAX_MSG_SIZE
+ * RETURN VALUE
+ * 	the handle of the queue(>= 0)
+ * 	-1: if error occured
+ */
+int sys_mq_create(uint32_t depth, uint32_t msg_size)
+{
+	/* bound both, so the rounding and the pool size can't wrap */
+	if (depth == 0 || depth > MQ_MAX_DEPTH || msg_size == 0 ||
+	    msg_size > MQ_MAX_MSG_SIZE || msg_size > 0xffffffff / depth) {
+		return -1;
+	}
+
+	for (int i = 0; i < MQ_MAX; i++) {
+		struct mq *q = &mqs[i];
+		if (q->pool) {
+			continue;
+		}
+
+		/* keep the buffers word aligned */
+		uint32_t stride = (msg_size + 3) & ~3;
+		q->pool = kmalloc(depth * stride);
+		if (q->pool == NULL) {
+			return -1;
+		}
+		q->depth = depth;
+		q->msg_size = msg_size;
+		q->stride = stride;
+		q->free = (depth == 32) ? 0xffffffff : (1 << depth) - 1;
+		q->queued = 0;
+		q->head = q->tail = 0;
+		q->senders.tasks = 0;
+		q->receivers.tasks = 0;
+		return q->gen * MQ_MAX + i;
+	}
+	return -1;
+}
+
+/*
+ * DESCRIPTION
+ * 	Destroy a message queue, the messages in it are dropped and the tasks
+ * 	blocked on it get an error.
+ * RETURN VALUE
+ * 	0: success
+ * 	-1: if the handle is invalid
+ */
+int sys_mq_destroy(int handle)
+{
+	struct mq *q = mq_get(handle);
+	if (q == NULL) {
+		return -1;
+	}
+
+	kfree(q->pool);
+	q->pool = NULL;
+	q->gen = (q->gen + 1) % MQ_GEN_MAX;
+	wake_up(&q->senders);
+	wake_up(&q->receivers);
+	return 0;
+}
+
+/*
+ * DESCRIPTION
+ * 	Take a buffer of the queue for a zero-copy message, block till one is
+ * 	free.
+ * RETURN VALUE
+ * 	the buffer of msg_size bytes
+ * 	NULL: if the handle is invalid
+ */
+void *sys_mq_alloc(int handle)
+{
+	struct mq *q = mq_get(handle);
+	if (q == NULL) {
+		return NULL;
+	}
+	return mq_buf_alloc(q);
+}
+
+/*
+ * DESCRIPTION
+ * 	Give back a buffer of the queue, from mq_alloc() or mq_receive(),
+ * 	which is not queued.
+ * RETURN VALUE
+ * 	0: success
+ * 	-1: if error occured
+ */
+int sys_mq_free(int handle, void *buf)
+{
+	struct mq *q = mq_get(handle);
+	int i;
+	if (q == NULL || (i = mq_buf_index(q, buf)) < 0 ||
+	    ((q->free | q->queued) & (1 << i))) {
+		return -1;
+	}
+	mq_buf_free(q, i);
+	return 0;
+}
+
+/*
+ * DESCRIPTION
+ * 	Send a message, block till a buffer is free.
+ * 	- msg: a buffer from mq_alloc(), which is queued as is if it isn't
+ * 	  queued yet, or any other msg_size bytes, which are copied
+ * RETURN VALUE
+ * 	0: success
+ * 	-1: if error occured
+ */
+int sys_mq_send(int handle, void *msg)
+{
+	struct mq *q = mq_get(handle);
+	if (q == NULL || msg == NULL) {
+		return -1;
+	}
+
+	uint8_t *buf = msg;
+	int i = mq_buf_index(q, msg);
+	if (i >= 0) {
+		if ((q->free | q->queued) & (1 << i)) {
+			return -1;
+		}
+	} else {
+		buf = mq_buf_alloc(q);
+		mq_copy(buf, msg, q->msg_size);
+		i = mq_buf_index(q, buf);
+	}
+	q->queued |= 1 << i;
+
+	/*
+	 * there are as many slots in the ring as buffers, and a buffer is
+	 * queued once at most, it can't be full
+	 */
+	q->ring[q->tail % q->depth] = buf;
+	q->tail++;
+	wake_up(&q->receivers);
+	return 0;
+}
+
+/*
+ * DESCRIPTION
+ * 	Check if a message is queued, for wait_any(), see wait.c.
+ * 	- wq: returns the wait queue to wait on for a message
+ * RETURN VALUE
+ * 	1: a message is queued
+ * 	0: none is queued
+ * 	-1: if the handle is invalid
+ */
+int mq_poll(int handle, struct wait_queue **wq)
+{
+	struct mq *q = mq_get(handle);
+	if (q == NULL) {
+		return -1;
+	}
+	*wq = &q->receivers;
+	return q->head != q->tail;
+}
+
+/*
+ * DESCRIPTION
+ * 	Receive a message, block till one is queued.
+ * 	- buf: where to copy the message to, the buffer of the message is
+ * 	  freed then. If NULL, the buffer itself is returned, and the caller
+ * 	  should give it back by mq_free().
+ * RETURN VALUE
+ * 	buf, or the buffer of the message if buf is NULL
+ * 	NULL: if error occured
+ */
+void *sys_mq_receive(int handle, void *buf)
+{
+	struct mq *q = mq_get(handle);
+	if (q == NULL) {
+		return NULL;
+	}
+
+	if (q->head == q->tail) {
+		syscall_wait(&q->receivers);
+	}
+	uint8_t *msg = q->ring[q->head % q->depth];
+	q->head++;
+	q->queued &= ~(1 << mq_buf_index(q, msg));
+
+	if (buf == NULL) {
+		return msg;
+	}
+	mq_copy(buf, msg, q->msg_size);
+	mq_buf_free(q, mq_buf_index(q, msg));
+	return buf;
+}
@@ -0,0 +1,60 @@
+#include "user_api.h"
+
+/*
+ * A mutex for the user tasks, which can't call spin_lock() as it writes
+ * mstatus.
+ *
+ * The state is 0 when unlocked, 1 when locked, and 2 when locked and some
+ * task may be waiting for it. Taking a free mutex and releasing one with
+ * no waiters is a single atomic instruction, lr/sc or amoadd, and traps
+ * only when the mutex is contended, see futex.c.
+ */
+#define MUTEX_UNLOCKED  0
+#define MUTEX_LOCKED    1
+#define MUTEX_CONTENDED 2
+
+void mutex_init(struct mutex *m)
+{
+	m->state = MUTEX_UNLOCKED;
+}
+
+/*
+ * DESCRIPTION
+ * 	Take the mutex if it is free, without blocking.
+ * RETURN VALUE
+ * 	0: success
+ * 	-1: if the mutex is locked
+ */
+int mutex_trylock(struct mutex *m)
+{
+	int c = MUTEX_UNLOCKED;
+	if (__atomic_compare_exchange_n(&m->state, &c, MUTEX_LOCKED, 0,
+					__ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+		return 0;
+	}
+	return -1;
+}
+
+void mutex_lock(struct mutex *m)
+{
+	if (mutex_trylock(m) == 0) {
+		return;
+	}
+
+	/*
+	 * mark it contended, so the owner wakes us up on unlock. Whoever gets
+	 * it from here on keeps it contended, as others may still wait.
+	 */
+	while (__atomic_exchange_n(&m->state, MUTEX_CONTENDED,
+				   __ATOMIC_ACQUIRE) != MUTEX_UNLOCKED) {
+		futex_wait(&m->state, MUTEX_CONTENDED);
+	}
+}
+
+void mutex_unlock(struct mutex *m)
+{
+	if (__atomic_fetch_sub(&m->state, 1, __ATOMIC_RELEASE) != MUTEX_LOCKED) {
+		__atomic_store_n(&m->state, MUTEX_UNLOCKED, __ATOMIC_RELEASE);
+		futex_wake(&m->state, 1);
+	}
+}
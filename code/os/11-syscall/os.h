@@ -4,24 +4,119 @@
 #include "types.h"
 #include "riscv.h"
 #include "platform.h"
+#include "log.h"
+#include "vdso.h"
+#include "pipe.h"
 
 #include <stddef.h>
 #include <stdarg.h>
 
 /* uart */
+#define UART_NONBLOCK (1 << 0)
+extern int uart_write(const char *buf, int len, int flags);
 extern int uart_putc(char ch);
 extern void uart_puts(char *s);
 extern int uart_getc(void);
+extern void uart_flush(void);
+extern uint32_t uart_tx_pending(void);
+extern int uart_tx_done(void);
+extern uint32_t uart_rx_count(void);
+extern void uart_irq_raise(void);
+
+/* tty, the line discipline of the console */
+struct wait_queue;
+#define TTY_ICANON (1 << 0)
+#define TTY_ECHO   (1 << 1)
+extern void tty_receive(char c);
+extern int tty_read(char *buf, int n);
+extern struct wait_queue *tty_wait_queue(void);
+extern int tty_poll(void);
+extern void tty_set_mode(int mode);
 
 /* printf */
 extern int  printf(const char* s, ...);
+extern int  snprintf(char *out, size_t n, const char *s, ...);
+extern int  vsnprintf(char *out, size_t n, const char *s, va_list vl);
+extern int  vsinkprintf(void (*out)(void *arg, char c), void *arg,
+			const char *s, va_list vl);
 extern void panic(char *s);
 
+/* lib */
+extern uint64_t udiv64(uint64_t n, uint64_t d, uint64_t *rem);
+
+/*
+ * binary log
+ * blog(fmt, ...) records the message to be formatted later by the host, see
+ * blog.c. fmt must be a string literal, and the arguments are 32-bit words:
+ * %d %i %u %x %X %c %p, and %s only for strings in .rodata or .data.
+ * Without CONFIG_BLOG, it is the same as printf().
+ */
+#ifdef CONFIG_BLOG
+#define blog(fmt, ...) \
+	do { \
+		reg_t __blog_args[] = { 0, ##__VA_ARGS__ }; \
+		blog_write("" fmt "", &__blog_args[1], \
+			   sizeof(__blog_args) / sizeof(reg_t) - 1); \
+	} while (0)
+#else
+#define blog(fmt, ...) printf(fmt, ##__VA_ARGS__)
+#endif
+extern void blog_write(const char *fmt, const reg_t *args, int nargs);
+extern void blog_kick(void);
+extern void blog_flush(void);
+
+/*
+ * event tracer, see trace.c
+ * trace(type, arg0, arg1) is a static tracepoint, it compiles to nothing
+ * without CONFIG_TRACE.
+ */
+#define TRACE_SWITCH		1	/* arg0: previous task, arg1: next task */
+#define TRACE_TRAP_ENTER	2	/* arg0: mcause, arg1: mepc */
+#define TRACE_TRAP_EXIT		3	/* arg0: mcause, arg1: return pc */
+#define TRACE_IRQ_CLAIM		4	/* arg0: irq */
+#define TRACE_IRQ_COMPLETE	5	/* arg0: irq */
+#define TRACE_TIMER		6	/* arg0: tick, arg1: callback, 0 for tick */
+#define TRACE_SYSCALL_ENTER	7	/* arg0: syscall number, arg1: a0 */
+#define TRACE_SYSCALL_EXIT	8	/* arg0: syscall number, arg1: return */
+
+#ifdef CONFIG_TRACE
+#define trace(type, arg0, arg1) trace_record(type, (reg_t)(arg0), (reg_t)(arg1))
+#else
+#define trace(type, arg0, arg1) do {} while (0)
+#endif
+extern void trace_record(int type, reg_t arg0, reg_t arg1);
+extern void trace_dump(void);
+
+/* profiler, see profile.c */
+extern void profile_sample(reg_t pc);
+extern void profile_dump(void);
+
+/*
+ * hardware performance counters, see perf.c
+ * The counters of each task, task -1 is the idle task, and TASK_SELF is the
+ * calling task.
+ */
+#define PERF_NR_HPM 4	/* mhpmcounter3 ~ mhpmcounter6 */
+struct perf_stat {
+	uint64_t cycles;
+	uint64_t instret;
+	uint64_t hpm[PERF_NR_HPM];
+	uint32_t switches;
+};
+extern void perf_switch(int prev);
+extern int perf_get(int task, struct perf_stat *st);
+
 /* memory management */
+extern uint32_t HEAP_SIZE;	/* defined in mem.S */
 extern void *page_alloc(int npages);
 extern void page_free(void *p);
+extern void *kmalloc(size_t size);
+extern void kfree(void *ptr);
 
 /* task management */
+#define MAX_TASKS 10
+#define TASK_SELF (-2)	/* the calling task, for the APIs taking a task id */
+
 struct context {
 	/* ignore x0 */
 	reg_t ra;
@@ -62,16 +157,175 @@ struct context {
 };
 
 extern int  task_create(void (*task)(void));
+extern int  ktask_create(void (*task)(void));
+extern int  task_current(void);
+extern struct context *task_context(int task);
+extern void schedule(void);
+extern void schedule_to(int next_id);
+extern int  task_stack_usage(int task);
+extern int  stack_guard_hit(reg_t addr);
+extern void task_stack_show(void);
 extern void task_delay(volatile int count);
 extern void task_yield();
+extern void task_exit(int status);
+
+/*
+ * scheduler statistics, see schedstat.c
+ * The times are in mtime ticks, and latency[] is the histogram of the
+ * wakeup-to-run latency: latency[0] counts those under 1us, latency[i]
+ * those in [2^(i-1), 2^i) us, and the last one all the longer ones.
+ */
+#define SCHED_LAT_BUCKETS 20
+struct sched_stat {
+	uint64_t run_time;
+	uint64_t wait_time;	/* ready to run, but not running */
+	uint32_t nr_voluntary;	/* switches by blocking or task_yield() */
+	uint32_t nr_involuntary;	/* switches by the timer */
+	uint32_t nr_wakeups;
+	uint32_t max_latency;
+	uint32_t latency[SCHED_LAT_BUCKETS];
+};
+extern void schedstat_ready(int task);
+extern void schedstat_wakeup(int task);
+extern void schedstat_switch(int prev, int next, int voluntary);
+extern int schedstat_get(int task, struct sched_stat *st);
+extern void schedstat_show(void);
+
+/* wait queue, each bit stands for a task waiting on it */
+struct wait_queue {
+	uint32_t tasks;
+};
+extern void wait_queue_sleep(struct wait_queue *wq);
+extern void wait_queue_remove(struct wait_queue *wq);
+extern void wake_up(struct wait_queue *wq);
+extern void syscall_wait(struct wait_queue *wq);
+extern void syscall_block(struct wait_queue *wq, reg_t ret);
+extern reg_t syscall_invoke(uint32_t num, reg_t a0, reg_t a1, reg_t a2);
+extern int syscall_ring_safe(uint32_t num);
+extern int syscall_sleep(uint32_t ticks, reg_t ret);
+
+/* work queue */
+struct work {
+	void (*func)(void *arg);
+	void *arg;
+	struct work *next;
+	int pending;
+};
+struct workqueue;
+extern struct workqueue *workqueue_create(void);
+extern void work_init(struct work *w, void (*func)(void *arg), void *arg);
+extern int queue_work_on(struct workqueue *wq, struct work *w);
+extern int queue_work(struct work *w);
+
+/*
+ * syscall rings, see uring.c
+ * A task queues system calls in the submission queue (sq) and makes one
+ * ring_enter() to run them all, their results come back in the completion
+ * queue (cq). Each side only moves its own index: the task moves sq_tail
+ * and cq_head, the kernel sq_head and cq_tail.
+ */
+#define URING_ENTRIES 16	/* must be a power of 2 */
+#define URING_OP_TIMEOUT 0x100	/* complete after arg0 ticks */
+
+struct uring_sqe {
+	uint32_t op;		/* a syscall number, or URING_OP_TIMEOUT */
+	reg_t args[3];
+	reg_t user_data;	/* passed back in the completion */
+};
+
+struct uring_cqe {
+	reg_t user_data;
+	reg_t res;		/* the return value of the system call */
+};
+
+struct uring {
+	volatile uint32_t sq_head;
+	volatile uint32_t sq_tail;
+	volatile uint32_t cq_head;
+	volatile uint32_t cq_tail;
+	volatile uint32_t cq_overflow;	/* completions lost as cq is full */
+	struct uring_sqe sq[URING_ENTRIES];
+	struct uring_cqe cq[URING_ENTRIES];
+};
+extern int sys_ring_enter(struct uring *ring, uint32_t min_complete);
+
+/* futex */
+extern int sys_futex_wait(int *addr, int val);
+extern int sys_futex_wake(int *addr, int n);
+
+/* shared memory */
+extern int sys_shm_create(size_t size);
+extern void *sys_shm_map(int handle);
+extern int sys_shm_unmap(int handle);
+extern int sys_shm_size(int handle);
+extern void shm_exit(int task);
+
+/* message queues */
+extern int sys_mq_create(uint32_t depth, uint32_t msg_size);
+extern int sys_mq_destroy(int handle);
+extern void *sys_mq_alloc(int handle);
+extern int sys_mq_free(int handle, void *buf);
+extern int sys_mq_send(int handle, void *msg);
+extern void *sys_mq_receive(int handle, void *buf);
+extern int mq_poll(int handle, struct wait_queue **wq);
+
+/* synchronous IPC */
+extern reg_t sys_ipc_call_regs(void);
+extern reg_t sys_ipc_reply_wait_regs(void);
+extern void ipc_exit(int task);
+
+/* pipes, see pipe.h */
+extern struct pipe *sys_pipe_create(uint32_t size);
+extern int sys_pipe_destroy(struct pipe *p);
+extern int sys_pipe_wait(struct pipe *p, uint32_t side);
+extern int sys_pipe_notify(struct pipe *p, uint32_t side);
+extern int pipe_write_nowait(struct pipe *p, const char *buf, int n);
+extern int pipe_read_nowait(struct pipe *p, char *buf, int n);
+extern int pipe_poll(int id, struct wait_queue **wq);
+extern void pipe_poll_cancel(int id);
+
+/*
+ * wait_any(), the handles of the objects to wait on, see wait.c.
+ * Each is ready when a read of it wouldn't block.
+ */
+#define WAIT_MAX 16
+#define WAIT_FOREVER (-1)
+#define WAIT_TYPE_SHIFT 16
+#define WAIT_ID_MASK ((1 << WAIT_TYPE_SHIFT) - 1)
+#define WAIT_TYPE_MQ   1
+#define WAIT_TYPE_PIPE 2
+#define WAIT_TYPE_TTY  3
+#define WAIT_MQ(handle) ((WAIT_TYPE_MQ << WAIT_TYPE_SHIFT) | (handle))
+#define WAIT_PIPE(p)    ((WAIT_TYPE_PIPE << WAIT_TYPE_SHIFT) | (p)->id)
+#define WAIT_TTY        (WAIT_TYPE_TTY << WAIT_TYPE_SHIFT)
+extern int sys_wait_any(const int *handles, int n, int timeout);
+
+/* vDSO data page, see vdso.c */
+extern void vdso_update_tick(uint32_t tick, uint64_t mtime);
+extern void vdso_update_task(int task);
 
 /* plic */
 extern int plic_claim(void);
 extern void plic_complete(int irq);
+extern void plic_set_priority(int irq, int priority);
+extern void plic_enable(int hart, int irq);
+extern void plic_disable(int hart, int irq);
+
+/* irq */
+extern int request_irq(int irq, void (*handler)(void *arg), void *arg, int priority);
+extern void free_irq(int irq);
+extern int irq_set_affinity(int irq, uint32_t hart_mask);
+extern uint32_t irq_get_affinity(int irq);
+extern void irq_hart_online(int hart);
+extern void irq_balance(void);
+extern uint32_t irq_get_count(int irq);
+extern void irq_show_stats(void);
 
 /* lock */
 extern int spin_lock(void);
 extern int spin_unlock(void);
+extern reg_t local_irq_save(void);
+extern void local_irq_restore(reg_t flags);
 
 /* software timer */
 struct timer {
@@ -81,5 +335,6 @@ struct timer {
 };
 extern struct timer *timer_create(void (*handler)(void *arg), void *arg, uint32_t timeout);
 extern void timer_delete(struct timer *timer);
+extern uint64_t get_mtime(void);
 
 #endif /* __OS_H__ */
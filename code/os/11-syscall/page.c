@@ -12,7 +12,6 @@ extern uint32_t RODATA_END;
 extern uint32_t BSS_START;
 extern uint32_t BSS_END;
 extern uint32_t HEAP_START;
-extern uint32_t HEAP_SIZE;
 
 /*
  * _alloc_start points to the actual start address of heap pool
@@ -107,6 +106,10 @@ void page_init()
  */
 void *page_alloc(int npages)
 {
+	if (npages <= 0) {
+		return NULL;
+	}
+
 	/* Note we are searching the page descriptor bitmaps. */
 	int found = 0;
 	struct Page *page_i = (struct Page *)HEAP_START;
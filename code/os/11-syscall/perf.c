@@ -0,0 +1,177 @@
+#include "os.h"
+
+/*
+ * Hardware performance counters.
+ *
+ * On every context switch, perf_switch() snapshots mcycle, minstret and the
+ * available mhpmcounters, and adds what they counted since the last switch
+ * to the task switched out. The counters of each task can be read by the
+ * perf_stat() syscall, and a top-like report of the last PERF_TOP seconds
+ * is printed periodically.
+ *
+ * The mhpmcounters may be hardwired to zero, e.g. on QEMU, so only those
+ * which can be written are used. What they count depends on mhpmevent,
+ * which is left as the platform sets it.
+ */
+#define PERF_SLOTS (MAX_TASKS + 1)	/* slot 0 is the idle task */
+
+static struct perf_stat perf_stats[PERF_SLOTS];
+static struct perf_stat perf_last;	/* snapshot at the last switch */
+static uint32_t perf_hpm_mask = 0;	/* available mhpmcounters */
+
+/* the mhpmcounters can only be accessed by their names */
+static uint64_t perf_read_hpm(int i)
+{
+	switch (i) {
+	case 0: return r_csr64(mhpmcounter3, mhpmcounter3h);
+	case 1: return r_csr64(mhpmcounter4, mhpmcounter4h);
+	case 2: return r_csr64(mhpmcounter5, mhpmcounter5h);
+	case 3: return r_csr64(mhpmcounter6, mhpmcounter6h);
+	}
+	return 0;
+}
+
+static void perf_write_hpm(int i, reg_t x)
+{
+	switch (i) {
+	case 0: w_csr(mhpmcounter3h, 0); w_csr(mhpmcounter3, x); break;
+	case 1: w_csr(mhpmcounter4h, 0); w_csr(mhpmcounter4, x); break;
+	case 2: w_csr(mhpmcounter5h, 0); w_csr(mhpmcounter5, x); break;
+	case 3: w_csr(mhpmcounter6h, 0); w_csr(mhpmcounter6, x); break;
+	}
+}
+
+static void perf_snapshot(struct perf_stat *st)
+{
+	st->cycles = r_csr64(mcycle, mcycleh);
+	st->instret = r_csr64(minstret, minstreth);
+	for (int i = 0; i < PERF_NR_HPM; i++) {
+		st->hpm[i] = (perf_hpm_mask & (1 << i)) ? perf_read_hpm(i) : 0;
+	}
+}
+
+/* add the counts from snapshot "from" to snapshot "to" to st */
+static void perf_add(struct perf_stat *st, struct perf_stat *from,
+		     struct perf_stat *to)
+{
+	st->cycles += to->cycles - from->cycles;
+	st->instret += to->instret - from->instret;
+	for (int i = 0; i < PERF_NR_HPM; i++) {
+		st->hpm[i] += to->hpm[i] - from->hpm[i];
+	}
+}
+
+/* this routine should be called in interrupt context (interrupt is disabled) */
+void perf_switch(int prev)
+{
+	struct perf_stat now;
+
+	perf_snapshot(&now);
+	perf_add(&perf_stats[prev + 1], &perf_last, &now);
+	perf_stats[prev + 1].switches++;
+	perf_last = now;
+}
+
+/*
+ * DESCRIPTION
+ * 	Get the counters of a task, including what it counted since it was
+ * 	switched in if it is running.
+ * 	- task: task id, -1 for the idle task, TASK_SELF for the running task
+ * RETURN VALUE
+ * 	0: success
+ * 	-1: if error occured
+ */
+int perf_get(int task, struct perf_stat *st)
+{
+	if (task == TASK_SELF) {
+		task = task_current();
+	}
+	if (task < -1 || task >= MAX_TASKS) {
+		return -1;
+	}
+
+	reg_t flags = local_irq_save();
+	*st = perf_stats[task + 1];
+	if (task == task_current()) {
+		struct perf_stat now;
+		perf_snapshot(&now);
+		perf_add(st, &perf_last, &now);
+	}
+	local_irq_restore(flags);
+
+	return 0;
+}
+
+/* x * 100 / y, x * 100 fits in 64 bits for years of cycles */
+static uint32_t perf_ratio100(uint64_t x, uint64_t y)
+{
+	return y ? (uint32_t)udiv64(x * 100, y, NULL) : 0;
+}
+
+#if PERF_TOP > 0
+static struct perf_stat perf_top_last[PERF_SLOTS];
+static struct work perf_top_work;
+
+static void perf_top_timeout(void *arg)
+{
+	queue_work(&perf_top_work);
+}
+
+/* print what each task counted since the last report, like top(1) */
+static void perf_top(void *arg)
+{
+	struct perf_stat delta[PERF_SLOTS];
+	uint64_t total = 0;
+
+	for (int i = 0; i < PERF_SLOTS; i++) {
+		struct perf_stat now;
+		perf_get(i - 1, &now);
+		delta[i] = now;
+		delta[i].cycles -= perf_top_last[i].cycles;
+		delta[i].instret -= perf_top_last[i].instret;
+		delta[i].switches -= perf_top_last[i].switches;
+		perf_top_last[i] = now;
+		total += delta[i].cycles;
+	}
+
+	printf("perf: last %d s, mhpmcounter mask 0x%x\n", PERF_TOP, perf_hpm_mask);
+	printf(" TASK   CPU%%           CYCLES          INSTRET   IPC SWITCHES\n");
+	for (int i = 0; i < PERF_SLOTS; i++) {
+		struct perf_stat *d = &delta[i];
+		if (d->cycles == 0) {
+			continue;
+		}
+		uint32_t cpu = perf_ratio100(d->cycles, total);
+		uint32_t ipc = perf_ratio100(d->instret, d->cycles);
+		if (i == 0) {
+			printf(" idle");
+		} else {
+			printf("%5d", i - 1);
+		}
+		printf(" %3d.%02d %16llu %16llu %d.%02d %8u\n",
+		       cpu / 100, cpu % 100, d->cycles, d->instret,
+		       ipc / 100, ipc % 100, d->switches);
+	}
+
+	timer_create(perf_top_timeout, NULL, PERF_TOP);
+}
+#endif
+
+void perf_init(void)
+{
+	/* the mhpmcounters hardwired to zero are not available */
+	for (int i = 0; i < PERF_NR_HPM; i++) {
+		perf_write_hpm(i, 1);
+		if (perf_read_hpm(i) != 0) {
+			perf_hpm_mask |= 1 << i;
+		}
+		perf_write_hpm(i, 0);
+	}
+
+	perf_snapshot(&perf_last);
+
+#if PERF_TOP > 0
+	work_init(&perf_top_work, perf_top, NULL);
+	timer_create(perf_top_timeout, NULL, PERF_TOP);
+#endif
+}
@@ -0,0 +1,236 @@
+#include "os.h"
+
+/*
+ * Pipes, the kernel side of pipe.h.
+ *
+ * The kernel creates the pipes and puts the ends to sleep: pipe_wait()
+ * checks the edge again with interrupt disabled before blocking, so it
+ * can't miss the other side moving data, which then sees the bit in
+ * waiting and calls pipe_notify(). The user tasks read and write by
+ * pipe_read() and pipe_write() in upipe.c, the kernel and the interrupt
+ * handlers by pipe_read_nowait() and pipe_write_nowait() here, e.g. to fan
+ * the input of the UART out to tasks.
+ *
+ * There is one producer and one consumer for each pipe, it is up to the
+ * users to keep it so. The wake-ups change the state of the scheduler,
+ * which runs on hart 0 only, so pipe_read_nowait() and pipe_write_nowait()
+ * must be called on hart 0, e.g. by an interrupt handler routed there.
+ */
+#define PIPE_MAX 8
+#define PIPE_MAX_SIZE 4096
+
+static struct pipe *pipes[PIPE_MAX];
+static struct wait_queue readers[PIPE_MAX];
+static struct wait_queue writers[PIPE_MAX];
+
+static int pipe_valid(struct pipe *p)
+{
+	for (int i = 0; i < PIPE_MAX; i++) {
+		if (p && pipes[i] == p) {
+			return 1;
+		}
+	}
+	return 0;
+}
+
+/* wake up the side of the pipe if it sleeps, interrupt must be disabled */
+static void pipe_wake(struct pipe *p, uint32_t side)
+{
+	if (!pipe_sleeping(p, side)) {
+		return;
+	}
+	__atomic_and_fetch(&p->waiting, ~side, __ATOMIC_SEQ_CST);
+	wake_up(side == PIPE_READER ? &readers[p->id] : &writers[p->id]);
+}
+
+/* if the side can move data, i.e. the pipe isn't empty, or isn't full */
+static int pipe_ready(struct pipe *p, uint32_t side)
+{
+	return side == PIPE_READER ? pipe_readable(p) != 0 : pipe_writable(p) != 0;
+}
+
+/*
+ * mark the side sleeping before checking the edge again, the fence pairs
+ * with the one in pipe_sleeping() of the other side. Return 1 if it is to
+ * sleep, 0 if the pipe got ready meanwhile.
+ */
+static int pipe_sleep_prepare(struct pipe *p, uint32_t side)
+{
+	__atomic_fetch_or(&p->waiting, side, __ATOMIC_SEQ_CST);
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	if (pipe_ready(p, side)) {
+		__atomic_fetch_and(&p->waiting, ~side, __ATOMIC_SEQ_CST);
+		return 0;
+	}
+	return 1;
+}
+
+/*
+ * DESCRIPTION
+ * 	Create a pipe.
+ * 	- size: the size of the ring in bytes, a power of 2 up to
+ * 	  PIPE_MAX_SIZE
+ * RETURN VALUE
+ * 	the pipe
+ * 	NULL: if error occured
+ */
+struct pipe *sys_pipe_create(uint32_t size)
+{
+	if (size == 0 || size > PIPE_MAX_SIZE || (size & (size - 1))) {
+		return NULL;
+	}
+
+	for (int i = 0; i < PIPE_MAX; i++) {
+		if (pipes[i]) {
+			continue;
+		}
+
+		struct pipe *p = kmalloc(sizeof(struct pipe) + size);
+		if (p == NULL) {
+			return NULL;
+		}
+		p->head = p->tail = 0;
+		p->size = size;
+		p->waiting = 0;
+		p->id = i;
+		pipes[i] = p;
+		return p;
+	}
+	return NULL;
+}
+
+/*
+ * DESCRIPTION
+ * 	Destroy a pipe, the tasks sleeping on it get an error.
+ * RETURN VALUE
+ * 	0: success
+ * 	-1: if error occured
+ */
+int sys_pipe_destroy(struct pipe *p)
+{
+	if (!pipe_valid(p)) {
+		return -1;
+	}
+
+	pipes[p->id] = NULL;
+	wake_up(&readers[p->id]);
+	wake_up(&writers[p->id]);
+	/* poison it, see pipe.h */
+	p->size = 0;
+	p->id = -1;
+	kfree(p);
+	return 0;
+}
+
+/*
+ * DESCRIPTION
+ * 	Sleep till the pipe is readable, for PIPE_READER, or writable, for
+ * 	PIPE_WRITER.
+ * RETURN VALUE
+ * 	0: success
+ * 	-1: if error occured
+ */
+int sys_pipe_wait(struct pipe *p, uint32_t side)
+{
+	if (!pipe_valid(p) || (side != PIPE_READER && side != PIPE_WRITER)) {
+		return -1;
+	}
+
+	if (!pipe_ready(p, side) && pipe_sleep_prepare(p, side)) {
+		syscall_wait(side == PIPE_READER ? &readers[p->id] :
+			     &writers[p->id]);
+	}
+	return 0;
+}
+
+/*
+ * DESCRIPTION
+ * 	Wake up the side of the pipe, PIPE_READER or PIPE_WRITER, if it
+ * 	sleeps, after moving data.
+ * RETURN VALUE
+ * 	0: success
+ * 	-1: if error occured
+ */
+int sys_pipe_notify(struct pipe *p, uint32_t side)
+{
+	if (!pipe_valid(p) || (side != PIPE_READER && side != PIPE_WRITER)) {
+		return -1;
+	}
+	pipe_wake(p, side);
+	return 0;
+}
+
+/*
+ * DESCRIPTION
+ * 	Check if a pipe is readable, for wait_any(), see wait.c. If it isn't,
+ * 	the reader is marked sleeping, so the writer wakes it up.
+ * 	- id: the id of the pipe
+ * 	- wq: returns the wait queue to wait on for data
+ * RETURN VALUE
+ * 	1: some data is readable
+ * 	0: the pipe is empty
+ * 	-1: if the id is invalid
+ */
+int pipe_poll(int id, struct wait_queue **wq)
+{
+	if (id < 0 || id >= PIPE_MAX || pipes[id] == NULL) {
+		return -1;
+	}
+
+	struct pipe *p = pipes[id];
+	*wq = &readers[id];
+	if (pipe_ready(p, PIPE_READER) || !pipe_sleep_prepare(p, PIPE_READER)) {
+		return 1;
+	}
+	return 0;
+}
+
+/*
+ * DESCRIPTION
+ * 	Undo pipe_poll() once wait_any() returns, so the writer doesn't keep
+ * 	trapping to wake up a reader which doesn't sleep.
+ * 	- id: the id of the pipe, ignored if invalid
+ */
+void pipe_poll_cancel(int id)
+{
+	if (id < 0 || id >= PIPE_MAX || pipes[id] == NULL) {
+		return;
+	}
+	__atomic_fetch_and(&pipes[id]->waiting, ~PIPE_READER, __ATOMIC_SEQ_CST);
+}
+
+/*
+ * DESCRIPTION
+ * 	Write to a pipe without blocking, from the kernel or an interrupt
+ * 	handler.
+ * RETURN VALUE
+ * 	the number of bytes written, less than n if the pipe is full
+ */
+int pipe_write_nowait(struct pipe *p, const char *buf, int n)
+{
+	reg_t flags = local_irq_save();
+	int ret = pipe_put(p, buf, n);
+	if (ret > 0) {
+		pipe_wake(p, PIPE_READER);
+	}
+	local_irq_restore(flags);
+	return ret;
+}
+
+/*
+ * DESCRIPTION
+ * 	Read from a pipe without blocking, from the kernel or an interrupt
+ * 	handler.
+ * RETURN VALUE
+ * 	the number of bytes read, 0 if the pipe is empty
+ */
+int pipe_read_nowait(struct pipe *p, char *buf, int n)
+{
+	reg_t flags = local_irq_save();
+	int ret = pipe_get(p, buf, n);
+	if (ret > 0) {
+		pipe_wake(p, PIPE_WRITER);
+	}
+	local_irq_restore(flags);
+	return ret;
+}
@@ -0,0 +1,96 @@
+#ifndef __PIPE_H__
+#define __PIPE_H__
+
+#include "types.h"
+
+/*
+ * A pipe is a byte stream through a ring buffer with a single producer and
+ * a single consumer, which the kernel, the user tasks and the interrupt
+ * handlers can all use, see pipe.c.
+ *
+ * Only the producer moves head and only the consumer moves tail, so the
+ * ring needs no lock: each side reads the index of the other with acquire,
+ * and publishes its own with release after the data. Moving data while
+ * the ring is neither empty nor full is done by the routines below, with
+ * no system call. A side only traps to sleep on the empty or full edge,
+ * and the kernel sets its bit in waiting, so the other side knows to wake
+ * it up after moving data. Each side stores its index, or its bit, before
+ * loading what the other side stores, with a full fence in between, so
+ * they can't both miss each other even on different harts.
+ *
+ * The user tasks use the pipe through its address, with no system call on
+ * the fast path, so a pipe must not be used after pipe_destroy(). Its ring
+ * is poisoned to look dead, size 0, but only till the memory is reused,
+ * possibly by another pipe at the same address.
+ */
+#define PIPE_READER (1 << 0)
+#define PIPE_WRITER (1 << 1)
+
+struct pipe {
+	uint32_t head;		/* bytes written, moved by the producer */
+	uint32_t tail;		/* bytes read, moved by the consumer */
+	uint32_t size;		/* a power of 2 */
+	uint32_t waiting;	/* PIPE_READER and PIPE_WRITER, who sleeps */
+	int id;
+	uint8_t data[];
+};
+
+static inline uint32_t pipe_readable(struct pipe *p)
+{
+	if (p->size == 0) {
+		return 0;
+	}
+	return __atomic_load_n(&p->head, __ATOMIC_ACQUIRE) - p->tail;
+}
+
+static inline uint32_t pipe_writable(struct pipe *p)
+{
+	if (p->size == 0) {
+		return 0;
+	}
+	return p->size - (p->head - __atomic_load_n(&p->tail, __ATOMIC_ACQUIRE));
+}
+
+/* copy at most n bytes into the ring, return the number of bytes copied */
+static inline uint32_t pipe_put(struct pipe *p, const char *buf, uint32_t n)
+{
+	uint32_t room = pipe_writable(p);
+	uint32_t head = p->head;
+
+	if (n > room) {
+		n = room;
+	}
+	for (uint32_t i = 0; i < n; i++) {
+		p->data[(head + i) & (p->size - 1)] = buf[i];
+	}
+	__atomic_store_n(&p->head, head + n, __ATOMIC_RELEASE);
+	return n;
+}
+
+/* copy at most n bytes out of the ring, return the number of bytes copied */
+static inline uint32_t pipe_get(struct pipe *p, char *buf, uint32_t n)
+{
+	uint32_t avail = pipe_readable(p);
+	uint32_t tail = p->tail;
+
+	if (n > avail) {
+		n = avail;
+	}
+	for (uint32_t i = 0; i < n; i++) {
+		buf[i] = p->data[(tail + i) & (p->size - 1)];
+	}
+	__atomic_store_n(&p->tail, tail + n, __ATOMIC_RELEASE);
+	return n;
+}
+
+/*
+ * whether the other side sleeps on the edge we just moved away from, the
+ * fence orders the store of our index before the load of waiting
+ */
+static inline int pipe_sleeping(struct pipe *p, uint32_t side)
+{
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	return __atomic_load_n(&p->waiting, __ATOMIC_ACQUIRE) & side;
+}
+
+#endif /* __PIPE_H__ */
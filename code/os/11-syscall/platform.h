@@ -52,13 +52,22 @@
  * #define VIRT_PLIC_SIZE(__num_context) \
  *     (VIRT_PLIC_CONTEXT_BASE + (__num_context) * VIRT_PLIC_CONTEXT_STRIDE)
  */
+#define PLIC_NUM_SOURCES 127
+#define PLIC_NUM_PRIORITIES 7
+
 #define PLIC_BASE 0x0c000000L
 #define PLIC_PRIORITY(id) (PLIC_BASE + (id) * 4)
 #define PLIC_PENDING(id) (PLIC_BASE + 0x1000 + ((id) / 32) * 4)
-#define PLIC_MENABLE(hart) (PLIC_BASE + 0x2000 + (hart) * 0x80)
-#define PLIC_MTHRESHOLD(hart) (PLIC_BASE + 0x200000 + (hart) * 0x1000)
-#define PLIC_MCLAIM(hart) (PLIC_BASE + 0x200004 + (hart) * 0x1000)
-#define PLIC_MCOMPLETE(hart) (PLIC_BASE + 0x200004 + (hart) * 0x1000)
+/*
+ * Each hart has two PLIC contexts due to VIRT_PLIC_HART_CONFIG "MS": context
+ * (2 * hart) is for Machine mode and context (2 * hart + 1) is for Supervisor
+ * mode, so the M-mode context of a hart is (2 * hart).
+ */
+#define PLIC_MCONTEXT(hart) ((hart) * 2)
+#define PLIC_MENABLE(hart) (PLIC_BASE + 0x2000 + PLIC_MCONTEXT(hart) * 0x80)
+#define PLIC_MTHRESHOLD(hart) (PLIC_BASE + 0x200000 + PLIC_MCONTEXT(hart) * 0x1000)
+#define PLIC_MCLAIM(hart) (PLIC_BASE + 0x200004 + PLIC_MCONTEXT(hart) * 0x1000)
+#define PLIC_MCOMPLETE(hart) (PLIC_BASE + 0x200004 + PLIC_MCONTEXT(hart) * 0x1000)
 
  /*
   * The Core Local INTerruptor (CLINT) block holds memory-mapped control and
@@ -3,32 +3,21 @@
 void plic_init(void)
 {
 	int hart = r_tp();
-  
-	/* 
-	 * Set priority for UART0.
-	 *
-	 * Each PLIC interrupt source can be assigned a priority by writing 
-	 * to its 32-bit memory-mapped priority register.
-	 * The QEMU-virt (the same as FU540-C000) supports 7 levels of priority. 
-	 * A priority value of 0 is reserved to mean "never interrupt" and 
-	 * effectively disables the interrupt. 
-	 * Priority 1 is the lowest active priority, and priority 7 is the highest. 
-	 * Ties between global interrupts of the same priority are broken by 
-	 * the Interrupt ID; interrupts with the lowest ID have the highest 
-	 * effective priority.
-	 */
-	*(uint32_t*)PLIC_PRIORITY(UART0_IRQ) = 1;
- 
+
 	/*
-	 * Enable UART0
+	 * Disable all the sources for this hart, each of them will be enabled
+	 * by request_irq() when the driver registers its handler.
 	 *
-	 * Each global interrupt can be enabled by setting the corresponding 
-	 * bit in the enables registers.
+	 * Each global interrupt can be enabled by setting the corresponding
+	 * bit in the enables registers. Source 0 is reserved, so the 127
+	 * sources of QEMU-virt take bit 1 to bit 127 of four 32-bit registers.
 	 */
-	*(uint32_t*)PLIC_MENABLE(hart)= (1 << UART0_IRQ);
+	for (int i = 0; i <= PLIC_NUM_SOURCES / 32; i++) {
+		*(uint32_t*)(PLIC_MENABLE(hart) + i * 4) = 0;
+	}
 
 	/* 
-	 * Set priority threshold for UART0.
+	 * Set priority threshold for this hart.
 	 *
 	 * PLIC will mask all interrupts of a priority less than or equal to threshold.
 	 * Maximum threshold is 7.
@@ -40,6 +29,46 @@ void plic_init(void)
 
 	/* enable machine-mode external interrupts. */
 	w_mie(r_mie() | MIE_MEIE);
+
+	irq_hart_online(hart);
+}
+
+/*
+ * DESCRIPTION:
+ *	Set the priority of an interrupt source.
+ *	Each PLIC interrupt source can be assigned a priority by writing
+ *	to its 32-bit memory-mapped priority register.
+ *	The QEMU-virt (the same as FU540-C000) supports 7 levels of priority.
+ *	A priority value of 0 is reserved to mean "never interrupt" and
+ *	effectively disables the interrupt.
+ *	Priority 1 is the lowest active priority, and priority 7 is the highest.
+ *	Ties between global interrupts of the same priority are broken by
+ *	the Interrupt ID; interrupts with the lowest ID have the highest
+ *	effective priority.
+ * RETURN VALUE: none
+ */
+void plic_set_priority(int irq, int priority)
+{
+	*(uint32_t*)PLIC_PRIORITY(irq) = priority;
+}
+
+/*
+ * DESCRIPTION:
+ *	Enable/disable the interrupt source irq for the M-mode context of hart.
+ *	An interrupt source is delivered to every hart which enables it, and
+ *	the first hart which claims it serves it.
+ * RETURN VALUE: none
+ */
+void plic_enable(int hart, int irq)
+{
+	uint32_t *reg = (uint32_t*)(PLIC_MENABLE(hart) + (irq / 32) * 4);
+	*reg = *reg | (1 << (irq % 32));
+}
+
+void plic_disable(int hart, int irq)
+{
+	uint32_t *reg = (uint32_t*)(PLIC_MENABLE(hart) + (irq / 32) * 4);
+	*reg = *reg & ~(1 << (irq % 32));
 }
 
 /* 
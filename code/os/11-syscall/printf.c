@@ -2,120 +2,282 @@
 
 /*
  * ref: https://github.com/cccriscv/mini-riscv-os/blob/master/05-Preemptive/lib.c
+ *
+ * The formatter works in a single pass and streams each character to a sink
+ * (see vsinkprintf()), so there is no staging buffer, no limit on the size
+ * of the output, and it is reentrant: tasks and interrupt handlers can print
+ * at the same time, each with its own sink.
+ *
+ * Supported: %d %i %u %x %X %p %s %c %%, the flags '-' (left-justify) and
+ * '0' (pad with zeros), a field width (digits or '*'), and the length
+ * modifiers 'l' and 'll' (64-bit).
  */
 
-static int _vsnprintf(char * out, size_t n, const char* s, va_list vl)
+struct fmt_spec {
+	int left;	/* '-' */
+	int zero;	/* '0' */
+	int width;
+};
+
+static void out_pad(void (*out)(void *arg, char c), void *arg, char c, int n)
+{
+	while (n-- > 0) {
+		out(arg, c);
+	}
+}
+
+/* output the digits in buf (len bytes, most significant first) with padding */
+static int out_number(void (*out)(void *arg, char c), void *arg,
+		      struct fmt_spec *spec, int neg, const char *prefix,
+		      const char *digits, int len)
+{
+	int plen = 0;
+	while (prefix[plen]) {
+		plen++;
+	}
+	int total = len + plen + (neg ? 1 : 0);
+	int pad = spec->width > total ? spec->width - total : 0;
+
+	if (!spec->left && !spec->zero) {
+		out_pad(out, arg, ' ', pad);
+	}
+	if (neg) {
+		out(arg, '-');
+	}
+	for (int i = 0; i < plen; i++) {
+		out(arg, prefix[i]);
+	}
+	if (!spec->left && spec->zero) {
+		out_pad(out, arg, '0', pad);
+	}
+	for (int i = 0; i < len; i++) {
+		out(arg, digits[i]);
+	}
+	if (spec->left) {
+		out_pad(out, arg, ' ', pad);
+	}
+	return total + pad;
+}
+
+static int out_decimal(void (*out)(void *arg, char c), void *arg,
+		       struct fmt_spec *spec, uint64_t num, int neg)
 {
-	int format = 0;
-	int longarg = 0;
-	size_t pos = 0;
+	char buf[20]; /* 2^64 has 20 digits */
+	int pos = sizeof(buf);
+	do {
+		uint64_t r;
+		num = udiv64(num, 10, &r);
+		buf[--pos] = '0' + r;
+	} while (num);
+	return out_number(out, arg, spec, neg, "", &buf[pos], sizeof(buf) - pos);
+}
+
+static int out_hex(void (*out)(void *arg, char c), void *arg,
+		   struct fmt_spec *spec, uint64_t num, int upper,
+		   const char *prefix)
+{
+	const char *hex = upper ? "0123456789ABCDEF" : "0123456789abcdef";
+	char buf[16];
+	int pos = sizeof(buf);
+	do {
+		buf[--pos] = hex[num & 0xF];
+		num >>= 4;
+	} while (num);
+	return out_number(out, arg, spec, 0, prefix, &buf[pos], sizeof(buf) - pos);
+}
+
+static int out_string(void (*out)(void *arg, char c), void *arg,
+		      struct fmt_spec *spec, const char *s)
+{
+	if (s == NULL) {
+		s = "(null)";
+	}
+	int len = 0;
+	while (s[len]) {
+		len++;
+	}
+	int pad = spec->width > len ? spec->width - len : 0;
+
+	if (!spec->left) {
+		out_pad(out, arg, ' ', pad);
+	}
+	for (int i = 0; i < len; i++) {
+		out(arg, s[i]);
+	}
+	if (spec->left) {
+		out_pad(out, arg, ' ', pad);
+	}
+	return len + pad;
+}
+
+/*
+ * DESCRIPTION
+ * 	Format s with vl, and pass the output to out(arg, c) one character at
+ * 	a time.
+ * RETURN VALUE
+ * 	the number of characters output.
+ */
+int vsinkprintf(void (*out)(void *arg, char c), void *arg,
+		const char *s, va_list vl)
+{
+	int pos = 0;
 	for (; *s; s++) {
-		if (format) {
-			switch(*s) {
-			case 'l': {
-				longarg = 1;
-				break;
-			}
-			case 'p': {
-				longarg = 1;
-				if (out && pos < n) {
-					out[pos] = '0';
-				}
-				pos++;
-				if (out && pos < n) {
-					out[pos] = 'x';
-				}
-				pos++;
-			}
-			case 'x': {
-				long num = longarg ? va_arg(vl, long) : va_arg(vl, int);
-				int hexdigits = 2*(longarg ? sizeof(long) : sizeof(int))-1;
-				for(int i = hexdigits; i >= 0; i--) {
-					int d = (num >> (4*i)) & 0xF;
-					if (out && pos < n) {
-						out[pos] = (d < 10 ? '0'+d : 'a'+d-10);
-					}
-					pos++;
-				}
-				longarg = 0;
-				format = 0;
-				break;
-			}
-			case 'd': {
-				long num = longarg ? va_arg(vl, long) : va_arg(vl, int);
-				if (num < 0) {
-					num = -num;
-					if (out && pos < n) {
-						out[pos] = '-';
-					}
-					pos++;
-				}
-				long digits = 1;
-				for (long nn = num; nn /= 10; digits++);
-				for (int i = digits-1; i >= 0; i--) {
-					if (out && pos + i < n) {
-						out[pos + i] = '0' + (num % 10);
-					}
-					num /= 10;
-				}
-				pos += digits;
-				longarg = 0;
-				format = 0;
-				break;
-			}
-			case 's': {
-				const char* s2 = va_arg(vl, const char*);
-				while (*s2) {
-					if (out && pos < n) {
-						out[pos] = *s2;
-					}
-					pos++;
-					s2++;
-				}
-				longarg = 0;
-				format = 0;
-				break;
-			}
-			case 'c': {
-				if (out && pos < n) {
-					out[pos] = (char)va_arg(vl,int);
-				}
-				pos++;
-				longarg = 0;
-				format = 0;
-				break;
+		if (*s != '%') {
+			out(arg, *s);
+			pos++;
+			continue;
+		}
+
+		struct fmt_spec spec = {0, 0, 0};
+		int longarg = 0;
+
+		/* flags */
+		for (s++; *s == '-' || *s == '0'; s++) {
+			if (*s == '-') {
+				spec.left = 1;
+			} else {
+				spec.zero = 1;
 			}
-			default:
-				break;
+		}
+		/* width */
+		if (*s == '*') {
+			spec.width = va_arg(vl, int);
+			if (spec.width < 0) {
+				spec.left = 1;
+				spec.width = -spec.width;
 			}
-		} else if (*s == '%') {
-			format = 1;
+			s++;
 		} else {
-			if (out && pos < n) {
-				out[pos] = *s;
+			for (; *s >= '0' && *s <= '9'; s++) {
+				spec.width = spec.width * 10 + (*s - '0');
 			}
+		}
+		/* length, 'l' is the same as int on RV32 */
+		for (; *s == 'l'; s++) {
+			longarg++;
+		}
+
+		switch (*s) {
+		case 'd':
+		case 'i': {
+			long long num = longarg >= 2 ? va_arg(vl, long long) :
+				(longarg ? va_arg(vl, long) : va_arg(vl, int));
+			int neg = num < 0;
+			uint64_t unum = neg ? -(uint64_t)num : (uint64_t)num;
+			pos += out_decimal(out, arg, &spec, unum, neg);
+			break;
+		}
+		case 'u': {
+			uint64_t num = longarg >= 2 ? va_arg(vl, unsigned long long) :
+				(longarg ? va_arg(vl, unsigned long) : va_arg(vl, unsigned int));
+			pos += out_decimal(out, arg, &spec, num, 0);
+			break;
+		}
+		case 'x':
+		case 'X': {
+			uint64_t num = longarg >= 2 ? va_arg(vl, unsigned long long) :
+				(longarg ? va_arg(vl, unsigned long) : va_arg(vl, unsigned int));
+			pos += out_hex(out, arg, &spec, num, *s == 'X', "");
+			break;
+		}
+		case 'p': {
+			/* always all the digits of the address */
+			uint64_t num = (reg_t)va_arg(vl, void *);
+			spec.zero = 1;
+			spec.width = 2 + 2 * sizeof(void *);
+			pos += out_hex(out, arg, &spec, num, 0, "0x");
+			break;
+		}
+		case 's':
+			pos += out_string(out, arg, &spec, va_arg(vl, const char *));
+			break;
+		case 'c': {
+			char c[2] = {(char)va_arg(vl, int), 0};
+			pos += out_string(out, arg, &spec, c);
+			break;
+		}
+		case '%':
+			out(arg, '%');
 			pos++;
+			break;
+		case '\0':
+			/* a single '%' at the end */
+			return pos;
+		default:
+			break;
 		}
-    	}
-	if (out && pos < n) {
-		out[pos] = 0;
-	} else if (out && n) {
-		out[n-1] = 0;
 	}
 	return pos;
 }
 
-static char out_buf[1000]; // buffer for _vprintf()
+/*
+ * Sink of a memory buffer, used by vsnprintf(), the output is truncated to
+ * n - 1 characters and always null-terminated.
+ */
+struct buf_sink {
+	char *out;
+	size_t n;
+	size_t pos;
+};
+
+static void buf_putc(void *arg, char c)
+{
+	struct buf_sink *sink = (struct buf_sink *)arg;
+	if (sink->pos + 1 < sink->n) {
+		sink->out[sink->pos] = c;
+	}
+	sink->pos++;
+}
+
+int vsnprintf(char *out, size_t n, const char *s, va_list vl)
+{
+	struct buf_sink sink = {out, n, 0};
+	int res = vsinkprintf(buf_putc, &sink, s, vl);
+	if (n > 0) {
+		out[sink.pos < n ? sink.pos : n - 1] = 0;
+	}
+	return res;
+}
+
+int snprintf(char *out, size_t n, const char *s, ...)
+{
+	int res = 0;
+	va_list vl;
+	va_start(vl, s);
+	res = vsnprintf(out, n, s, vl);
+	va_end(vl);
+	return res;
+}
+
+/*
+ * Sink of the UART, the characters are gathered in a small buffer on the
+ * stack of the caller and passed to the transmit ring of the UART in chunks.
+ */
+#define UART_SINK_CHUNK 32
+
+struct uart_sink {
+	char buf[UART_SINK_CHUNK];
+	int len;
+};
+
+static void uart_sink_putc(void *arg, char c)
+{
+	struct uart_sink *sink = (struct uart_sink *)arg;
+	sink->buf[sink->len++] = c;
+	if (sink->len == UART_SINK_CHUNK) {
+		uart_write(sink->buf, sink->len, 0);
+		sink->len = 0;
+	}
+}
 
 static int _vprintf(const char* s, va_list vl)
 {
-	int res = _vsnprintf(NULL, -1, s, vl);
-	if (res+1 >= sizeof(out_buf)) {
-		uart_puts("error: output string size overflow\n");
-		while(1) {}
+	struct uart_sink sink;
+	sink.len = 0;
+	int res = vsinkprintf(uart_sink_putc, &sink, s, vl);
+	if (sink.len > 0) {
+		uart_write(sink.buf, sink.len, 0);
 	}
-	_vsnprintf(out_buf, res + 1, s, vl);
-	uart_puts(out_buf);
 	return res;
 }
 
@@ -131,8 +293,11 @@ int printf(const char* s, ...)
 
 void panic(char *s)
 {
+	/* the pr_err() just before may still be in a blog ring */
+	blog_flush();
 	printf("panic: ");
 	printf(s);
 	printf("\n");
+	uart_flush();
 	while(1){};
 }
@@ -0,0 +1,64 @@
+#include "os.h"
+
+/*
+ * Statistical profiler.
+ *
+ * The timer interrupt samples the interrupted pc (mepc) and the running
+ * task PROFILE_HZ times a second, the scheduler tick still comes once a
+ * second, see timer_handler(). The samples are kept in a buffer, which
+ * stops recording when it is full.
+ *
+ * profile_dump() sends the samples over the UART as lines of hex words
+ * between "@P BEGIN <rate> <dropped>" and "@P END":
+ * 	@P <task> <pc>
+ * Pressing Ctrl-P on the console dumps the samples, and tools/profile.py
+ * maps them to the functions of os.elf and prints a flat profile.
+ */
+#define PROFILE_SAMPLES 4096
+
+struct profile_sample {
+	reg_t pc;
+	int task;
+};
+
+static struct profile_sample samples[PROFILE_SAMPLES];
+static uint32_t nr_samples = 0;
+static uint32_t nr_dropped = 0;
+static volatile int profile_on = 1;
+
+/* this routine should be called in interrupt context (interrupt is disabled) */
+void profile_sample(reg_t pc)
+{
+	if (!profile_on) {
+		return;
+	}
+
+	if (nr_samples >= PROFILE_SAMPLES) {
+		nr_dropped++;
+		return;
+	}
+
+	samples[nr_samples].pc = pc;
+	samples[nr_samples].task = task_current();
+	nr_samples++;
+}
+
+/*
+ * DESCRIPTION
+ * 	Send all the samples over the UART and start sampling over again.
+ * 	Sampling is paused while dumping. Called by kernel tasks.
+ */
+void profile_dump(void)
+{
+	profile_on = 0;
+
+	printf("@P BEGIN %d %d\n", PROFILE_HZ, nr_dropped);
+	for (uint32_t i = 0; i < nr_samples; i++) {
+		printf("@P %x %x\n", samples[i].task, samples[i].pc);
+	}
+	printf("@P END\n");
+
+	nr_samples = 0;
+	nr_dropped = 0;
+	profile_on = 1;
+}
@@ -99,4 +99,44 @@ static inline reg_t r_mcause()
 	return x;
 }
 
+/* cycle counter, the lower 32 bits of mcycle */
+static inline reg_t r_cycle()
+{
+	reg_t x;
+	asm volatile("rdcycle %0" : "=r" (x) );
+	return x;
+}
+
+/* Physical Memory Protection, the bits of each entry in pmpcfg */
+#define PMP_R     (1 << 0)
+#define PMP_W     (1 << 1)
+#define PMP_X     (1 << 2)
+#define PMP_TOR   (1 << 3)
+#define PMP_NAPOT (3 << 3)
+
+/*
+ * Access a CSR by its name, for the CSRs which have no helper above, e.g.
+ * the hardware performance counters.
+ */
+#define r_csr(csr) ({ \
+	reg_t __x; \
+	asm volatile("csrr %0, " #csr : "=r" (__x) ); \
+	__x; \
+})
+
+#define w_csr(csr, x) asm volatile("csrw " #csr ", %0" : : "r" ((reg_t)(x)))
+
+/*
+ * On RV32 a 64-bit counter takes two CSRs, e.g. mcycle and mcycleh, so read
+ * the high word again to make sure the low word didn't wrap in between.
+ */
+#define r_csr64(lo, hi) ({ \
+	uint32_t __hi, __lo; \
+	do { \
+		__hi = r_csr(hi); \
+		__lo = r_csr(lo); \
+	} while (__hi != r_csr(hi)); \
+	((uint64_t)__hi << 32) | __lo; \
+})
+
 #endif /* __RISCV_H__ */
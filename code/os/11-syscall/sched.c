@@ -3,32 +3,162 @@
 /* defined in entry.S */
 extern void switch_to(struct context *next);
 
-#define MAX_TASKS 10
 #define STACK_SIZE 1024
 /*
  * In the standard RISC-V calling convention, the stack pointer sp
  * is always 16-byte aligned.
+ * With CONFIG_PMP_GUARD, the lowest STACK_GUARD bytes of the stack of the
+ * running task can't be accessed by the user mode, so a stack overflow
+ * traps before it corrupts the stack of the next task. It is a NAPOT
+ * region of PMP, which must be aligned to its size.
  */
-uint8_t __attribute__((aligned(16))) task_stack[MAX_TASKS][STACK_SIZE];
+#define STACK_GUARD 64
+uint8_t __attribute__((aligned(STACK_GUARD))) task_stack[MAX_TASKS][STACK_SIZE];
 struct context ctx_tasks[MAX_TASKS];
 
+/*
+ * task_state holds the state of each task, only TASK_READY tasks can be
+ * picked by schedule(), and a TASK_EXITED task never runs again.
+ * task_mstatus holds the bits of mstatus to be set before switching to the
+ * task, i.e. which privilege mode (mstatus.MPP) the task runs in.
+ */
+#define TASK_READY   0
+#define TASK_BLOCKED 1
+#define TASK_EXITED  2
+static uint8_t task_state[MAX_TASKS];
+static reg_t task_mstatus[MAX_TASKS];
+
+/*
+ * The idle task runs in machine mode when no other task is ready, it just
+ * waits for the interrupts which would make some task ready again.
+ */
+#define IDLE_TASK (-1)
+static uint8_t __attribute__((aligned(16))) idle_stack[STACK_SIZE];
+static struct context ctx_idle;
+
 /*
  * _top is used to mark the max available position of ctx_tasks
  * _current is used to point to the context of current task
+ * _last is the last task picked by the round-robin, the idle task excluded
  */
 static int _top = 0;
 static int _current = -1;
+static int _last = -1;
+
+/* set by task_yield(), so schedule() can tell the switch is voluntary */
+static volatile int _yield = 0;
+
+/*
+ * The stacks are painted with STACK_PAINT when the tasks are created, the
+ * words which still hold it have never been used, so the lowest word
+ * overwritten tells the peak usage of a stack.
+ * A task whose sp goes past STACK_WARN percent of its stack is warned
+ * about once, and every STACK_CHECK seconds the usage of all the stacks
+ * is reported, 0 for no report.
+ */
+#define STACK_PAINT 0xdeadbeef
+#ifndef STACK_WARN
+#define STACK_WARN 75
+#endif
+#ifndef STACK_CHECK
+#define STACK_CHECK 0
+#endif
+static uint8_t stack_warned[MAX_TASKS];
+
+static void idle_task(void)
+{
+	while (1) {
+		asm volatile("wfi");
+	}
+}
+
+#ifdef CONFIG_PMP_GUARD
+/* point the guard region, PMP entry 0 set up in start.S, to the stack */
+static inline void stack_guard_set(uint8_t *stack)
+{
+	w_csr(pmpaddr0, ((reg_t)stack >> 2) | (STACK_GUARD / 8 - 1));
+}
+
+/*
+ * DESCRIPTION
+ * 	Tell if an access fault is caused by the guard region of the stack of
+ * 	the running task, i.e. the task overflows its stack.
+ * 	- addr: the faulting address, in mtval
+ */
+int stack_guard_hit(reg_t addr)
+{
+	if (_current < 0) {
+		return 0;
+	}
+	reg_t guard = (reg_t)task_stack[_current];
+	return addr >= guard && addr < guard + STACK_GUARD;
+}
+#endif
+
+static void stack_paint(uint8_t *stack)
+{
+	uint32_t *p = (uint32_t *)stack;
+	for (int i = 0; i < STACK_SIZE / 4; i++) {
+		p[i] = STACK_PAINT;
+	}
+}
+
+static int stack_used(uint8_t *stack)
+{
+	uint32_t *p = (uint32_t *)stack;
+	int i = 0;
+	while (i < STACK_SIZE / 4 && p[i] == STACK_PAINT) {
+		i++;
+	}
+	return STACK_SIZE - i * 4;
+}
+
+/* warn about a task switched out with its sp past the threshold */
+static void stack_check_sp(int id)
+{
+	reg_t used = (reg_t)&task_stack[id][STACK_SIZE] - ctx_tasks[id].sp;
+	if (!stack_warned[id] && used > STACK_SIZE * STACK_WARN / 100) {
+		stack_warned[id] = 1;
+		pr_warn(SCHED, "task %d uses %d of %d bytes of its stack\n",
+			id, used, STACK_SIZE);
+	}
+}
+
+#if STACK_CHECK > 0
+static struct work stack_work;
+
+static void stack_timeout(void *arg)
+{
+	queue_work(&stack_work);
+}
+
+static void stack_report(void *arg)
+{
+	task_stack_show();
+	timer_create(stack_timeout, NULL, STACK_CHECK);
+}
+#endif
 
 void sched_init()
 {
 	w_mscratch(0);
 
+	stack_paint(idle_stack);
+
+	ctx_idle.sp = (reg_t) &idle_stack[STACK_SIZE];
+	ctx_idle.pc = (reg_t) idle_task;
+
 	/* enable machine-mode software interrupts. */
 	w_mie(r_mie() | MIE_MSIE);
+
+#if STACK_CHECK > 0
+	work_init(&stack_work, stack_report, NULL);
+	timer_create(stack_timeout, NULL, STACK_CHECK);
+#endif
 }
 
 /*
- * implment a simple cycle FIFO schedular
+ * implment a simple cycle FIFO schedular, skipping the blocked tasks
  */
 void schedule()
 {
@@ -37,29 +167,181 @@ void schedule()
 		return;
 	}
 
-	_current = (_current + 1) % _top;
-	struct context *next = &(ctx_tasks[_current]);
+	int next_id = IDLE_TASK;
+	for (int i = 1; i <= _top; i++) {
+		int id = (_last + i) % _top;
+		if (task_state[id] == TASK_READY) {
+			next_id = id;
+			break;
+		}
+	}
+
+	schedule_to(next_id);
+}
+
+/*
+ * DESCRIPTION
+ * 	Switch to a task directly, without the round-robin scan of
+ * 	schedule(), e.g. from a client to its server in ipc.c.
+ * 	Must be called with interrupt disabled, it never returns.
+ * 	- next_id: a TASK_READY task, or IDLE_TASK
+ */
+void schedule_to(int next_id)
+{
+	struct context *next;
+	reg_t mstatus = r_mstatus() & ~MSTATUS_MPP;
+	trace(TRACE_SWITCH, _current, next_id);
+	if (_current >= 0) {
+		stack_check_sp(_current);
+	}
+#ifdef CONFIG_PERF
+	perf_switch(_current);
+#endif
+#ifdef CONFIG_SCHEDSTAT
+	schedstat_switch(_current, next_id, _yield ||
+			 (_current >= 0 && task_state[_current] == TASK_BLOCKED));
+#endif
+	_yield = 0;
+	_current = next_id;
+	vdso_update_task(next_id);
+	if (next_id == IDLE_TASK) {
+		next = &ctx_idle;
+		mstatus |= MSTATUS_MPP | MSTATUS_MPIE;
+	} else {
+		_last = next_id;
+		next = &(ctx_tasks[next_id]);
+		mstatus |= task_mstatus[next_id];
+#ifdef CONFIG_PMP_GUARD
+		stack_guard_set(task_stack[next_id]);
+#endif
+	}
+
+	/* MRET in switch_to() goes to the privilege mode held in mstatus.MPP */
+	w_mstatus(mstatus);
 	switch_to(next);
 }
 
+static int _task_create(void (*start_routin)(void), reg_t mstatus)
+{
+	if (_top < MAX_TASKS) {
+		stack_paint(task_stack[_top]);
+		ctx_tasks[_top].sp = (reg_t) &task_stack[_top][STACK_SIZE];
+		ctx_tasks[_top].pc = (reg_t) start_routin;
+		task_state[_top] = TASK_READY;
+		task_mstatus[_top] = mstatus;
+#ifdef CONFIG_SCHEDSTAT
+		schedstat_ready(_top);
+#endif
+		_top++;
+		return 0;
+	} else {
+		return -1;
+	}
+}
+
+/*
+ * DESCRIPTION
+ * 	Get the saved context of a task, which is what the task finds in its
+ * 	registers when it runs again.
+ * RETURN VALUE
+ * 	the context
+ * 	NULL: if there is no such task, or it has exited
+ */
+struct context *task_context(int task)
+{
+	if (task < 0 || task >= _top || task_state[task] == TASK_EXITED) {
+		return NULL;
+	}
+	return &ctx_tasks[task];
+}
+
+/*
+ * DESCRIPTION
+ * 	Get the id of the running task.
+ * RETURN VALUE
+ * 	task id(>= 0), or -1 for the idle task
+ */
+int task_current(void)
+{
+	return _current;
+}
+
 /*
  * DESCRIPTION
  * 	Create a task.
  * 	- start_routin: task routine entry
+ * 	The task runs in user mode when CONFIG_SYSCALL is defined, otherwise in
+ * 	machine mode.
  * RETURN VALUE
  * 	0: success
  * 	-1: if error occured
  */
 int task_create(void (*start_routin)(void))
 {
-	if (_top < MAX_TASKS) {
-		ctx_tasks[_top].sp = (reg_t) &task_stack[_top][STACK_SIZE];
-		ctx_tasks[_top].pc = (reg_t) start_routin;
-		_top++;
-		return 0;
-	} else {
+#ifdef CONFIG_SYSCALL
+	return _task_create(start_routin, 0);
+#else
+	return _task_create(start_routin, MSTATUS_MPP | MSTATUS_MPIE);
+#endif
+}
+
+/*
+ * DESCRIPTION
+ * 	Create a kernel task, which always runs in machine mode with
+ * 	interrupts enabled, so it can access CSRs and call spin_lock().
+ * RETURN VALUE
+ * 	task id(>= 0): success
+ * 	-1: if error occured
+ */
+int ktask_create(void (*start_routin)(void))
+{
+	int id = _top;
+	if (_task_create(start_routin, MSTATUS_MPP | MSTATUS_MPIE) < 0) {
+		return -1;
+	}
+	return id;
+}
+
+/*
+ * DESCRIPTION
+ * 	Get the peak stack usage of a task.
+ * 	- task: task id, -1 for the idle task, or TASK_SELF for the running task
+ * RETURN VALUE
+ * 	the most bytes of the stack ever used
+ * 	-1: if error occured
+ */
+int task_stack_usage(int task)
+{
+	if (task == TASK_SELF) {
+		task = _current;
+	}
+	if (task == IDLE_TASK) {
+		return stack_used(idle_stack);
+	}
+	if (task < 0 || task >= _top) {
 		return -1;
 	}
+	return stack_used(task_stack[task]);
+}
+
+/*
+ * DESCRIPTION
+ * 	Print the peak stack usage of all the tasks.
+ */
+void task_stack_show(void)
+{
+	printf("stack: %d bytes each, warn at %d%%\n", STACK_SIZE, STACK_WARN);
+	printf(" TASK  PEAK    %%\n");
+	for (int i = IDLE_TASK; i < _top; i++) {
+		int used = task_stack_usage(i);
+		if (i == IDLE_TASK) {
+			printf(" idle");
+		} else {
+			printf("%5d", i);
+		}
+		printf(" %5d %3d%s\n", used, used * 100 / STACK_SIZE,
+		       used > STACK_SIZE * STACK_WARN / 100 ? " !" : "");
+	}
 }
 
 /*
@@ -69,11 +351,27 @@ int task_create(void (*start_routin)(void))
  */
 void task_yield()
 {
+	_yield = 1;
+
 	/* trigger a machine-level software interrupt */
 	int id = r_mhartid();
 	*(uint32_t*)CLINT_MSIP(id) = 1;
 }
 
+/*
+ * DESCRIPTION
+ * 	Terminate the calling task and switch to another task, it never
+ * 	returns. The slot of the task is not reused.
+ * 	Must be called with interrupt disabled, e.g. in a system call.
+ * 	- status: the exit status, only logged
+ */
+void task_exit(int status)
+{
+	pr_info(SCHED, "task %d exited, status %d\n", _current, status);
+	task_state[_current] = TASK_EXITED;
+	schedule();
+}
+
 /*
  * a very rough implementaion, just to consume the cpu
  */
@@ -83,3 +381,83 @@ void task_delay(volatile int count)
 	while (count--);
 }
 
+/*
+ * DESCRIPTION
+ * 	Put the calling task on the wait queue and block it, the task won't
+ * 	be picked by schedule() until wake_up() is called on the queue.
+ * 	Must be called with interrupt disabled, and the caller should release
+ * 	the CPU right after, e.g. a kernel task calls task_yield() and then
+ * 	spin_unlock(), and re-check its condition when it runs again.
+ */
+void wait_queue_sleep(struct wait_queue *wq)
+{
+	if (_current < 0) {
+		return;
+	}
+	wq->tasks |= (1 << _current);
+	task_state[_current] = TASK_BLOCKED;
+}
+
+/*
+ * DESCRIPTION
+ * 	Take the calling task off the wait queue, e.g. when it waited on
+ * 	several queues and one of them woke it up.
+ * 	Must be called with interrupt disabled.
+ */
+void wait_queue_remove(struct wait_queue *wq)
+{
+	if (_current < 0) {
+		return;
+	}
+	wq->tasks &= ~(1 << _current);
+}
+
+/*
+ * DESCRIPTION
+ * 	Make all the tasks waiting on the queue ready again.
+ * 	Must be called with interrupt disabled, e.g. from an interrupt handler.
+ */
+void wake_up(struct wait_queue *wq)
+{
+	for (int i = 0; i < _top; i++) {
+		if (wq->tasks & (1 << i)) {
+#ifdef CONFIG_SCHEDSTAT
+			if (task_state[i] == TASK_BLOCKED && i != _current) {
+				schedstat_wakeup(i);
+			}
+#endif
+			task_state[i] = TASK_READY;
+		}
+	}
+	wq->tasks = 0;
+}
+
+/*
+ * DESCRIPTION
+ * 	Block the calling task on the wait queue in a system call, and switch
+ * 	to another task. It never returns: the context of the task still
+ * 	points to the ecall, so the system call is executed again once the
+ * 	task is woken up, and it can check its condition again.
+ */
+void syscall_wait(struct wait_queue *wq)
+{
+	wait_queue_sleep(wq);
+	schedule();
+}
+
+/*
+ * DESCRIPTION
+ * 	Block the calling task on the wait queue in a system call, and switch
+ * 	to another task. It never returns: unlike syscall_wait(), the system
+ * 	call is done, and the task goes on after the ecall with ret as its
+ * 	return value once it is woken up.
+ */
+void syscall_block(struct wait_queue *wq, reg_t ret)
+{
+	struct context *cxt = &ctx_tasks[_current];
+
+	cxt->a0 = ret;
+	cxt->pc += 4;
+	wait_queue_sleep(wq);
+	schedule();
+}
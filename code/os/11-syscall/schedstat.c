@@ -0,0 +1,171 @@
+#include "os.h"
+
+/*
+ * Scheduler statistics.
+ *
+ * The scheduler reports the state changes of the tasks, and the time each
+ * task spends running, and ready to run but waiting for the CPU, is
+ * measured with mtime. The time from wake_up() till the task runs is its
+ * wakeup latency, which goes to a histogram.
+ *
+ * A task can read its own statistics or those of others with the
+ * sched_stat() syscall, and pressing Ctrl-S on the console prints them all.
+ * They show how long the tasks wait for the CPU, which is what the time
+ * slices and priorities of a scheduler are tuned for.
+ */
+static struct sched_stat stats[MAX_TASKS];
+static uint64_t ran_since[MAX_TASKS];	/* when it was switched in */
+static uint64_t ready_since[MAX_TASKS];	/* when it got ready to run */
+static uint8_t woken[MAX_TASKS];	/* made ready by wake_up() */
+static uint64_t idle_time = 0;
+static uint64_t idle_since = 0;
+
+/* mtime ticks to us, clamped to 32 bits */
+static uint32_t ticks_to_us(uint64_t ticks)
+{
+	uint64_t us = udiv64(ticks, CLINT_TIMEBASE_FREQ / 1000000, NULL);
+	return (us >> 32) ? 0xffffffff : (uint32_t)us;
+}
+
+static void record_latency(struct sched_stat *st, uint64_t ticks)
+{
+	uint32_t us = ticks_to_us(ticks);
+	int i = 0;
+
+	while (us && i < SCHED_LAT_BUCKETS - 1) {
+		us >>= 1;
+		i++;
+	}
+	st->latency[i]++;
+	st->nr_wakeups++;
+	if (ticks > st->max_latency) {
+		st->max_latency = (ticks >> 32) ? 0xffffffff : (uint32_t)ticks;
+	}
+}
+
+/*
+ * The following routines are called by the scheduler, they should be
+ * called in interrupt context (interrupt is disabled).
+ */
+
+/* a new task is ready to run */
+void schedstat_ready(int task)
+{
+	ready_since[task] = get_mtime();
+}
+
+/* a blocked task is made ready by wake_up() */
+void schedstat_wakeup(int task)
+{
+	ready_since[task] = get_mtime();
+	woken[task] = 1;
+}
+
+/*
+ * The CPU is switched from prev to next, either may be the idle task (-1).
+ * voluntary tells if prev gave up the CPU by itself, by blocking or by
+ * task_yield(), rather than being preempted.
+ */
+void schedstat_switch(int prev, int next, int voluntary)
+{
+	uint64_t now = get_mtime();
+
+	if (prev == next) {
+		return;
+	}
+
+	if (prev < 0) {
+		idle_time += now - idle_since;
+	} else {
+		stats[prev].run_time += now - ran_since[prev];
+		if (voluntary) {
+			stats[prev].nr_voluntary++;
+		} else {
+			stats[prev].nr_involuntary++;
+		}
+		/* if it is still ready to run, it waits for the CPU from now on */
+		ready_since[prev] = now;
+	}
+
+	if (next < 0) {
+		idle_since = now;
+	} else {
+		stats[next].wait_time += now - ready_since[next];
+		if (woken[next]) {
+			record_latency(&stats[next], now - ready_since[next]);
+			woken[next] = 0;
+		}
+		ran_since[next] = now;
+	}
+}
+
+/*
+ * DESCRIPTION
+ * 	Get the scheduler statistics of a task, including the time it has
+ * 	been running if it is running.
+ * 	- task: task id, or TASK_SELF for the running task
+ * RETURN VALUE
+ * 	0: success
+ * 	-1: if error occured
+ */
+int schedstat_get(int task, struct sched_stat *st)
+{
+	if (task == TASK_SELF) {
+		task = task_current();
+	}
+	if (task < 0 || task >= MAX_TASKS) {
+		return -1;
+	}
+
+	reg_t flags = local_irq_save();
+	*st = stats[task];
+	if (task == task_current()) {
+		st->run_time += get_mtime() - ran_since[task];
+	}
+	local_irq_restore(flags);
+
+	return 0;
+}
+
+/*
+ * DESCRIPTION
+ * 	Print the statistics of all the tasks which have run.
+ * 	Called by kernel tasks.
+ */
+void schedstat_show(void)
+{
+	struct sched_stat st;
+	uint32_t ms = CLINT_TIMEBASE_FREQ / 1000;
+
+	printf("sched: uptime %llu ms, idle %llu ms\n",
+	       udiv64(get_mtime(), ms, NULL), udiv64(idle_time, ms, NULL));
+	printf(" TASK      RUN(ms)     WAIT(ms)      VOL    INVOL  WAKEUPS MAXLAT(us)\n");
+	for (int i = 0; i < MAX_TASKS; i++) {
+		if (schedstat_get(i, &st) < 0 || st.run_time == 0) {
+			continue;
+		}
+		printf("%5d %12llu %12llu %8u %8u %8u %10u\n", i,
+		       udiv64(st.run_time, ms, NULL),
+		       udiv64(st.wait_time, ms, NULL),
+		       st.nr_voluntary, st.nr_involuntary, st.nr_wakeups,
+		       ticks_to_us(st.max_latency));
+	}
+
+	for (int i = 0; i < MAX_TASKS; i++) {
+		if (schedstat_get(i, &st) < 0 || st.nr_wakeups == 0) {
+			continue;
+		}
+		printf("wakeup latency of task %d:\n", i);
+		for (int b = 0; b < SCHED_LAT_BUCKETS; b++) {
+			if (st.latency[b] == 0) {
+				continue;
+			}
+			uint32_t lo = b ? 1 << (b - 1) : 0;
+			if (b == SCHED_LAT_BUCKETS - 1) {
+				printf("  %8u us ~          %8u\n", lo, st.latency[b]);
+			} else {
+				printf("  %8u us ~ %8u us %8u\n", lo, 1 << b, st.latency[b]);
+			}
+		}
+	}
+}
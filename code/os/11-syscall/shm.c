@@ -0,0 +1,157 @@
+#include "os.h"
+
+/*
+ * Shared memory objects.
+ *
+ * A task creates an object of some pages from page_alloc(), and gets a
+ * handle to it. The handle, rather than the data, is what is passed to
+ * the other tasks, e.g. in a message, and each task maps the object by the
+ * handle to get its address, so a large buffer moves through a pipeline of
+ * tasks without being copied.
+ *
+ * An object records which tasks have it mapped, and its pages are freed
+ * when the last of them unmaps it or exits, so the sender should keep it
+ * mapped till the receiver has mapped it. A handle carries a generation
+ * number, so a stale handle of a freed object doesn't map the object which
+ * reuses its slot.
+ *
+ * All the tasks share one address space for now, and the PMP lets the user
+ * mode access the whole memory, so mapping only hands out the address. The
+ * mappings are what a PMP or Sv32 based isolation would enforce.
+ */
+#define PAGE_SIZE 4096
+
+#define SHM_MAX 16
+#define SHM_SLOT(handle) ((handle) % SHM_MAX)
+#define SHM_GEN(handle) ((handle) / SHM_MAX)
+
+struct shm {
+	void *base;		/* NULL for a free slot */
+	uint32_t size;		/* in bytes, a multiple of PAGE_SIZE */
+	uint32_t maps;		/* a bit for each task which has it mapped */
+	uint32_t gen;
+};
+
+static struct shm shms[SHM_MAX];
+
+static struct shm *shm_get(int handle)
+{
+	if (handle < 0) {
+		return NULL;
+	}
+	struct shm *s = &shms[SHM_SLOT(handle)];
+	if (s->base == NULL || s->gen != SHM_GEN(handle)) {
+		return NULL;
+	}
+	return s;
+}
+
+static void shm_put(struct shm *s, int task)
+{
+	s->maps &= ~(1 << task);
+	if (s->maps == 0) {
+		page_free(s->base);
+		s->base = NULL;
+		s->gen++;
+	}
+}
+
+/*
+ * DESCRIPTION
+ * 	Create a shared memory object, it is mapped by the calling task.
+ * 	- size: the number of bytes, rounded up to pages
+ * RETURN VALUE
+ * 	the handle of the object(>= 0)
+ * 	-1: if error occured
+ */
+int sys_shm_create(size_t size)
+{
+	/* don't let the rounding to pages wrap */
+	if (size == 0 || size > HEAP_SIZE) {
+		return -1;
+	}
+
+	for (int i = 0; i < SHM_MAX; i++) {
+		struct shm *s = &shms[i];
+		if (s->base) {
+			continue;
+		}
+
+		int npages = (size + PAGE_SIZE - 1) / PAGE_SIZE;
+		s->base = page_alloc(npages);
+		if (s->base == NULL) {
+			return -1;
+		}
+		s->size = npages * PAGE_SIZE;
+		s->maps = 1 << task_current();
+		/* the handle must stay positive */
+		s->gen &= 0x7ffffff;
+		return s->gen * SHM_MAX + i;
+	}
+	return -1;
+}
+
+/*
+ * DESCRIPTION
+ * 	Map a shared memory object into the calling task, mapping it again is
+ * 	harmless.
+ * RETURN VALUE
+ * 	the address of the object
+ * 	NULL: if the handle is invalid
+ */
+void *sys_shm_map(int handle)
+{
+	struct shm *s = shm_get(handle);
+	if (s == NULL) {
+		return NULL;
+	}
+	s->maps |= 1 << task_current();
+	return s->base;
+}
+
+/*
+ * DESCRIPTION
+ * 	Unmap a shared memory object from the calling task, the object is
+ * 	freed if no task has it mapped.
+ * RETURN VALUE
+ * 	0: success
+ * 	-1: if the handle is invalid or not mapped
+ */
+int sys_shm_unmap(int handle)
+{
+	struct shm *s = shm_get(handle);
+	int id = task_current();
+	if (s == NULL || !(s->maps & (1 << id))) {
+		return -1;
+	}
+	shm_put(s, id);
+	return 0;
+}
+
+/*
+ * DESCRIPTION
+ * 	Get the size of a shared memory object.
+ * RETURN VALUE
+ * 	the size in bytes
+ * 	-1: if the handle is invalid
+ */
+int sys_shm_size(int handle)
+{
+	struct shm *s = shm_get(handle);
+	return s ? (int)s->size : -1;
+}
+
+/*
+ * DESCRIPTION
+ * 	Unmap all the shared memory objects of an exiting task.
+ * 	Must be called with interrupt disabled, e.g. in a system call.
+ */
+void shm_exit(int task)
+{
+	for (int i = 0; i < SHM_MAX; i++) {
+		struct shm *s = &shms[i];
+		if (s->base && (s->maps & (1 << task))) {
+			shm_put(s, task);
+		}
+	}
+}
@@ -3,7 +3,7 @@
 
 int sys_gethid(unsigned int *ptr_hid)
 {
-	printf("--> sys_gethid, arg0 = 0x%x\n", ptr_hid);
+	pr_debug(SYSCALL, "--> sys_gethid, arg0 = %p\n", (reg_t)ptr_hid);
 	if (ptr_hid == NULL) {
 		return -1;
 	} else {
@@ -12,18 +12,218 @@ int sys_gethid(unsigned int *ptr_hid)
 	}
 }
 
+/*
+ * Only fd 0, the console, is supported. The calling task is blocked till
+ * some input is readable, see syscall_wait().
+ */
+int sys_read(int fd, char *buf, int n)
+{
+	if (fd != 0 || buf == NULL || n < 0) {
+		return -1;
+	}
+	if (n == 0) {
+		return 0;
+	}
+
+	int ret = tty_read(buf, n);
+	if (ret == -1) {
+		syscall_wait(tty_wait_queue());
+	}
+	return ret;
+}
+
+/*
+ * The counters of a task, see perf_get(), only with CONFIG_PERF.
+ */
+int sys_perf_stat(int task, struct perf_stat *st)
+{
+#ifdef CONFIG_PERF
+	if (st == NULL) {
+		return -1;
+	}
+	return perf_get(task, st);
+#else
+	return -1;
+#endif
+}
+
+/*
+ * The scheduler statistics of a task, see schedstat_get(), only with
+ * CONFIG_SCHEDSTAT.
+ */
+int sys_sched_stat(int task, struct sched_stat *st)
+{
+#ifdef CONFIG_SCHEDSTAT
+	if (st == NULL) {
+		return -1;
+	}
+	return schedstat_get(task, st);
+#else
+	return -1;
+#endif
+}
+
+/*
+ * Only fd 1 and 2, the console, are supported.
+ */
+int sys_write(int fd, const char *buf, int n)
+{
+	if ((fd != 1 && fd != 2) || buf == NULL || n < 0) {
+		return -1;
+	}
+	return uart_write(buf, n, 0);
+}
+
+int sys_yield(void)
+{
+	task_yield();
+	return 0;
+}
+
+/*
+ * The calling task is blocked on its own wait queue, and a software timer
+ * wakes it up, see syscall_block().
+ */
+static struct wait_queue sleepers[MAX_TASKS];
+
+static void sleep_timeout(void *arg)
+{
+	wake_up((struct wait_queue *)arg);
+}
+
+/*
+ * DESCRIPTION
+ * 	Block the calling task in a system call for some ticks, the system
+ * 	call returns ret when the task wakes up.
+ * RETURN VALUE
+ * 	ret: at once if ticks is 0
+ * 	-1: if error occured
+ * 	It doesn't return otherwise.
+ */
+int syscall_sleep(uint32_t ticks, reg_t ret)
+{
+	struct wait_queue *wq = &sleepers[task_current()];
+
+	if (ticks == 0) {
+		return ret;
+	}
+	if (timer_create(sleep_timeout, wq, ticks) == NULL) {
+		return -1;
+	}
+	syscall_block(wq, ret);
+	return ret;
+}
+
+int sys_sleep(uint32_t ticks)
+{
+	return syscall_sleep(ticks, 0);
+}
+
+int sys_exit(int status)
+{
+	shm_exit(task_current());
+	ipc_exit(task_current());
+	task_exit(status);
+	return 0;
+}
+
+int sys_getpid(void)
+{
+	return task_current();
+}
+
+int sys_get_time(uint64_t *time)
+{
+	if (time == NULL) {
+		return -1;
+	}
+	*time = get_mtime();
+	return 0;
+}
+
+/*
+ * Do nothing, for measuring the cost of a system call, see trapbench.c.
+ */
+int sys_nop(void)
+{
+	return 0;
+}
+
+void *sys_malloc(size_t size)
+{
+	return kmalloc(size);
+}
+
+int sys_free(void *ptr)
+{
+	kfree(ptr);
+	return 0;
+}
+
+/*
+ * The syscall table, indexed by the numbers in syscall.h. The system calls
+ * take at most 3 arguments, in a0 ~ a2, and all the arguments and return
+ * values fit in a register, so they are called through one type.
+ */
+typedef reg_t (*syscall_t)(reg_t a0, reg_t a1, reg_t a2);
+
+#define SYSCALL_ENTRY(name, num, ring) [num] = (syscall_t)sys_##name,
+static const syscall_t syscall_table[] = {
+	SYSCALLS(SYSCALL_ENTRY)
+};
+#undef SYSCALL_ENTRY
+
+#define NR_SYSCALLS (sizeof(syscall_table) / sizeof(syscall_t))
+
+#define SYSCALL_RING(name, num, ring) [num] = ring,
+static const uint8_t syscall_ring[NR_SYSCALLS] = {
+	SYSCALLS(SYSCALL_RING)
+};
+#undef SYSCALL_RING
+
+/*
+ * DESCRIPTION
+ * 	Tell if the system call of the number can be batched in a uring,
+ * 	see syscall.h.
+ * RETURN VALUE
+ * 	1: if it can
+ * 	0: if it can't, or the number is unknown
+ */
+int syscall_ring_safe(uint32_t num)
+{
+	return num < NR_SYSCALLS && syscall_ring[num];
+}
+
+/*
+ * DESCRIPTION
+ * 	Call the system call of the number with the arguments, for the
+ * 	system calls made by the kernel on behalf of a task, e.g. uring.c.
+ * RETURN VALUE
+ * 	the return value of the system call
+ * 	-1: if the number is unknown
+ */
+reg_t syscall_invoke(uint32_t num, reg_t a0, reg_t a1, reg_t a2)
+{
+	if (num < NR_SYSCALLS && syscall_table[num]) {
+		return syscall_table[num](a0, a1, a2);
+	}
+	pr_warn(SYSCALL, "Unknown syscall no: %d\n", num);
+	return -1;
+}
+
 void do_syscall(struct context *cxt)
 {
 	uint32_t syscall_num = cxt->a7;
 
-	switch (syscall_num) {
-	case SYS_gethid:
-		cxt->a0 = sys_gethid((unsigned int *)(cxt->a0));
-		break;
-	default:
-		printf("Unknown syscall no: %d\n", syscall_num);
-		cxt->a0 = -1;
-	}
+	/*
+	 * A syscall which blocks the task switches to another task and has no
+	 * TRACE_SYSCALL_EXIT, see syscall_wait() and syscall_block().
+	 */
+	trace(TRACE_SYSCALL_ENTER, syscall_num, cxt->a0);
+
+	cxt->a0 = syscall_invoke(syscall_num, cxt->a0, cxt->a1, cxt->a2);
+
+	trace(TRACE_SYSCALL_EXIT, syscall_num, cxt->a0);
 
 	return;
-}
\ No newline at end of file
+}
@@ -1,2 +1,64 @@
+#ifndef __SYSCALL_H__
+#define __SYSCALL_H__
+
+/*
+ * The list of the system calls, SYSCALL(name, number, ring) for each of
+ * them. It is the only place to add a system call:
+ * - SYS_<name> is defined below as its number,
+ * - usys.S makes the user stub <name>() which traps with the number in a7,
+ * - syscall.c puts sys_<name>() in the syscall table at the number.
+ * The user API is declared in user_api.h. The numbers must be unique and
+ * never reused, as user programs depend on them.
+ * ring is 1 if the system call can be batched in a uring, see uring.c.
+ * Those which block by syscall_wait() are safe, as the ring_enter() is
+ * restarted with their entry still queued. Those which block by
+ * syscall_block() would complete ring_enter() itself, so they need their
+ * own case in uring.c, like sleep, or ring 0. ring must also be 0 for those
+ * which take arguments other than a0 ~ a2 from the context, as they would
+ * act on the context of ring_enter().
+ */
+#define SYSCALLS(SYSCALL) \
+	SYSCALL(gethid,		1,	1) \
+	SYSCALL(read,		2,	1) \
+	SYSCALL(perf_stat,	3,	1) \
+	SYSCALL(sched_stat,	4,	1) \
+	SYSCALL(write,		5,	1) \
+	SYSCALL(yield,		6,	1) \
+	SYSCALL(sleep,		7,	1) \
+	SYSCALL(exit,		8,	1) \
+	SYSCALL(getpid,		9,	1) \
+	SYSCALL(get_time,	10,	1) \
+	SYSCALL(malloc,		11,	1) \
+	SYSCALL(free,		12,	1) \
+	SYSCALL(ring_enter,	13,	0) \
+	SYSCALL(nop,		14,	1) \
+	SYSCALL(futex_wait,	15,	0) \
+	SYSCALL(futex_wake,	16,	1) \
+	SYSCALL(shm_create,	17,	1) \
+	SYSCALL(shm_map,	18,	1) \
+	SYSCALL(shm_unmap,	19,	1) \
+	SYSCALL(shm_size,	20,	1) \
+	SYSCALL(mq_create,	21,	1) \
+	SYSCALL(mq_destroy,	22,	1) \
+	SYSCALL(mq_alloc,	23,	1) \
+	SYSCALL(mq_free,	24,	1) \
+	SYSCALL(mq_send,	25,	1) \
+	SYSCALL(mq_receive,	26,	1) \
+	SYSCALL(ipc_call_regs,	27,	0) \
+	SYSCALL(ipc_reply_wait_regs, 28,	0) \
+	SYSCALL(pipe_create,	29,	1) \
+	SYSCALL(pipe_destroy,	30,	1) \
+	SYSCALL(pipe_wait,	31,	1) \
+	SYSCALL(pipe_notify,	32,	1) \
+	SYSCALL(wait_any,	33,	1)
+
+#ifndef __ASSEMBLER__
 // System call numbers
-#define SYS_gethid	1
+#define SYSCALL_NUMBER(name, num, ring) SYS_##name = num,
+enum {
+	SYSCALLS(SYSCALL_NUMBER)
+};
+#undef SYSCALL_NUMBER
+#endif
+
+#endif /* __SYSCALL_H__ */
@@ -5,6 +5,18 @@ extern void schedule(void);
 /* interval ~= 1s */
 #define TIMER_INTERVAL CLINT_TIMEBASE_FREQ
 
+/*
+ * The profiler samples at PROFILE_HZ, so the timer interrupt comes
+ * PROFILE_HZ times a second and the tick is counted once every PROFILE_HZ
+ * interrupts, which keeps the tick at ~1s.
+ */
+#ifdef CONFIG_PROFILE
+#define TIMER_LOAD_INTERVAL (TIMER_INTERVAL / PROFILE_HZ)
+static uint32_t _subtick = 0;
+#else
+#define TIMER_LOAD_INTERVAL TIMER_INTERVAL
+#endif
+
 static uint32_t _tick = 0;
 
 #define MAX_TIMER 10
@@ -19,6 +31,21 @@ void timer_load(int interval)
 	*(uint64_t*)CLINT_MTIMECMP(id) = *(uint64_t*)CLINT_MTIME + interval;
 }
 
+/*
+ * read the 64-bit mtime, on RV32 it takes two loads, so read the high word
+ * again to make sure the low word didn't wrap in between.
+ */
+uint64_t get_mtime(void)
+{
+	volatile uint32_t *mtime = (volatile uint32_t *)CLINT_MTIME;
+	uint32_t hi, lo;
+	do {
+		hi = mtime[1];
+		lo = mtime[0];
+	} while (hi != mtime[1]);
+	return ((uint64_t)hi << 32) | lo;
+}
+
 void timer_init()
 {
 	struct timer *t = &(timer_list[0]);
@@ -32,7 +59,7 @@ void timer_init()
 	 * On reset, mtime is cleared to zero, but the mtimecmp registers 
 	 * are not reset. So we have to init the mtimecmp manually.
 	 */
-	timer_load(TIMER_INTERVAL);
+	timer_load(TIMER_LOAD_INTERVAL);
 
 	/* enable machine-mode timer interrupts. */
 	w_mie(r_mie() | MIE_MTIE);
@@ -45,18 +72,22 @@ struct timer *timer_create(void (*handler)(void *arg), void *arg, uint32_t timeo
 		return NULL;
 	}
 
-	/* use lock to protect the shared timer_list between multiple tasks */
-	spin_lock();
+	/*
+	 * protect the shared timer_list between multiple tasks, and keep
+	 * interrupts disabled if they were, e.g. in a system call
+	 */
+	reg_t flags = local_irq_save();
 
 	struct timer *t = &(timer_list[0]);
-	for (int i = 0; i < MAX_TIMER; i++) {
+	int i;
+	for (i = 0; i < MAX_TIMER; i++) {
 		if (NULL == t->func) {
 			break;
 		}
 		t++;
 	}
-	if (NULL != t->func) {
-		spin_unlock();
+	if (i == MAX_TIMER) {
+		local_irq_restore(flags);
 		return NULL;
 	}
 
@@ -64,14 +95,14 @@ struct timer *timer_create(void (*handler)(void *arg), void *arg, uint32_t timeo
 	t->arg = arg;
 	t->timeout_tick = _tick + timeout;
 
-	spin_unlock();
+	local_irq_restore(flags);
 
 	return t;
 }
 
 void timer_delete(struct timer *timer)
 {
-	spin_lock();
+	reg_t flags = local_irq_save();
 
 	struct timer *t = &(timer_list[0]);
 	for (int i = 0; i < MAX_TIMER; i++) {
@@ -83,7 +114,7 @@ void timer_delete(struct timer *timer)
 		t++;
 	}
 
-	spin_unlock();
+	local_irq_restore(flags);
 }
 
 /* this routine should be called in interrupt context (interrupt is disabled) */
@@ -93,6 +124,7 @@ static inline void timer_check()
 	for (int i = 0; i < MAX_TIMER; i++) {
 		if (NULL != t->func) {
 			if (_tick >= t->timeout_tick) {
+				trace(TRACE_TIMER, _tick, t->func);
 				t->func(t->arg);
 
 				/* once time, just delete it after timeout */
@@ -108,12 +140,32 @@ static inline void timer_check()
 
 void timer_handler() 
 {
+#ifdef CONFIG_PROFILE
+	/* mepc still holds the pc interrupted by the timer */
+	profile_sample(r_mepc());
+	if (++_subtick < PROFILE_HZ) {
+		timer_load(TIMER_LOAD_INTERVAL);
+		return;
+	}
+	_subtick = 0;
+#endif
+
 	_tick++;
-	printf("tick: %d\n", _tick);
+	vdso_update_tick(_tick, get_mtime());
+	trace(TRACE_TIMER, _tick, 0);
+	pr_info(TIMER, "tick: %d\n", _tick);
 
 	timer_check();
 
-	timer_load(TIMER_INTERVAL);
+#ifdef CONFIG_IRQ_BALANCE
+	irq_balance();
+#endif
+
+#ifdef CONFIG_BLOG
+	blog_kick();
+#endif
+
+	timer_load(TIMER_LOAD_INTERVAL);
 
 	schedule();
 }
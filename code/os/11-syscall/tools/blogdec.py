@@ -0,0 +1,88 @@
+#!/usr/bin/env python3
+"""
+Decode the binary log of RVOS (built with "make BLOG=y").
+
+The kernel sends each record of blog() as a line of hex words:
+    @L <hart> <format address> <mtime> <arg0> <arg1> ...
+This tool reads the format strings from os.elf and prints the messages,
+prefixed with the time in seconds and the hart id. Other lines of the
+console are printed as they are.
+
+usage: blogdec.py os.elf [console.log]    (stdin if no log is given)
+e.g.:  make BLOG=y run | tee console.log; tools/blogdec.py os.elf console.log
+"""
+
+import re
+import sys
+
+from elf import Elf
+
+TIMEBASE_FREQ = 10000000  # CLINT_TIMEBASE_FREQ in platform.h
+
+CONV = re.compile(r'%([-0]*)(\d*)(l*)([diuxXcsp%])')
+
+
+def format_message(elf, fmt, args):
+    args = list(args)
+
+    def conv(m):
+        flags, width, _, kind = m.groups()
+        if kind == '%':
+            return '%'
+        value = args.pop(0) if args else 0
+        spec = '%' + flags + width
+        if kind in 'di':
+            if value & 0x80000000:
+                value -= 1 << 32
+            return (spec + 'd') % value
+        if kind in 'uxX':
+            return (spec + kind) % value
+        if kind == 'c':
+            return (spec + 'c') % chr(value & 0xff)
+        if kind == 'p':
+            return '0x%08x' % value
+        s = elf.read_string(value)
+        return (spec + 's') % (s if s is not None else '<0x%08x>' % value)
+
+    return CONV.sub(conv, fmt)
+
+
+def main():
+    if len(sys.argv) < 2:
+        sys.exit(__doc__)
+    elf = Elf(sys.argv[1])
+    log = open(sys.argv[2], 'r', errors='replace') if len(sys.argv) > 2 else sys.stdin
+
+    # mtime is recorded in 32 bits, keep counting after it wraps
+    last = None
+    high = 0
+    for line in log:
+        pos = line.find('@L ')
+        if pos < 0:
+            sys.stdout.write(line)
+            continue
+        # text printed before the record on the same line
+        sys.stdout.write(line[:pos])
+        try:
+            words = [int(w, 16) for w in line[pos + 3:].split()]
+            hart, fmt_addr, mtime, args = words[0], words[1], words[2], words[3:]
+        except (ValueError, IndexError):
+            sys.stdout.write(line[pos:])
+            continue
+
+        if last is not None and mtime < last:
+            high += 1 << 32
+        last = mtime
+
+        fmt = elf.read_string(fmt_addr)
+        if fmt is None:
+            msg = '<unknown format 0x%08x> %s\n' % (fmt_addr, ' '.join('%x' % a for a in args))
+        else:
+            msg = format_message(elf, fmt, args)
+        sys.stdout.write('[%12.6f] [hart %d] %s' % ((high + mtime) / TIMEBASE_FREQ, hart, msg))
+        if not msg.endswith('\n'):
+            sys.stdout.write('\n')
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,90 @@
+"""
+Minimal reader of the 32-bit little-endian RISC-V ELF files built by RVOS,
+just enough for the host tools: read the bytes at a virtual address from the
+allocated sections, and look up symbols. No third-party package is needed.
+"""
+
+import struct
+
+
+class Elf(object):
+    def __init__(self, path):
+        with open(path, 'rb') as f:
+            self.data = f.read()
+        if self.data[:4] != b'\x7fELF' or self.data[4] != 1:
+            raise ValueError('%s: not a 32-bit ELF file' % path)
+
+        (e_shoff,) = struct.unpack_from('<I', self.data, 0x20)
+        e_shentsize, e_shnum, e_shstrndx = struct.unpack_from('<HHH', self.data, 0x2e)
+
+        self.sections = []
+        for i in range(e_shnum):
+            fields = struct.unpack_from('<IIIIIIIIII', self.data, e_shoff + i * e_shentsize)
+            self.sections.append({
+                'name_off': fields[0], 'type': fields[1], 'flags': fields[2],
+                'addr': fields[3], 'offset': fields[4], 'size': fields[5],
+                'link': fields[6], 'entsize': fields[9],
+            })
+        strtab = self.sections[e_shstrndx]
+        for sec in self.sections:
+            sec['name'] = self._cstr(strtab['offset'] + sec['name_off'])
+
+        self.symbols = self._load_symbols()
+
+    def _cstr(self, off):
+        end = self.data.index(b'\0', off)
+        return self.data[off:end].decode('latin-1')
+
+    def _load_symbols(self):
+        """Return the function/object symbols sorted by address."""
+        syms = []
+        for sec in self.sections:
+            if sec['name'] != '.symtab':
+                continue
+            strtab = self.sections[sec['link']]
+            for off in range(sec['offset'], sec['offset'] + sec['size'], 16):
+                name_off, value, size, info = struct.unpack_from('<IIIB', self.data, off)
+                if (info & 0xf) not in (1, 2):  # STT_OBJECT, STT_FUNC
+                    continue
+                syms.append((value, size, self._cstr(strtab['offset'] + name_off), info & 0xf))
+        syms.sort()
+        return syms
+
+    def read(self, addr, size):
+        """Bytes at addr from a section with contents, None if not found."""
+        for sec in self.sections:
+            if sec['type'] == 8 or not (sec['flags'] & 0x2):  # NOBITS, !ALLOC
+                continue
+            if sec['addr'] <= addr and addr + size <= sec['addr'] + sec['size']:
+                off = sec['offset'] + addr - sec['addr']
+                return self.data[off:off + size]
+        return None
+
+    def read_string(self, addr):
+        """The C string at addr, None if addr is not in the image."""
+        for sec in self.sections:
+            if sec['type'] == 8 or not (sec['flags'] & 0x2):
+                continue
+            if sec['addr'] <= addr < sec['addr'] + sec['size']:
+                off = sec['offset'] + addr - sec['addr']
+                end = self.data.index(b'\0', off)
+                return self.data[off:end].decode('latin-1')
+        return None
+
+    def function_at(self, addr):
+        """Name of the function containing addr, None if not found."""
+        lo, hi = 0, len(self.symbols)
+        while lo < hi:
+            mid = (lo + hi) // 2
+            if self.symbols[mid][0] <= addr:
+                lo = mid + 1
+            else:
+                hi = mid
+        for i in range(lo - 1, -1, -1):
+            value, size, name, kind = self.symbols[i]
+            if kind != 2:
+                continue
+            if addr < value + max(size, 1):
+                return name
+            break
+        return None
@@ -0,0 +1,90 @@
+#!/usr/bin/env python3
+"""
+Print a flat profile of RVOS (built with "make PROFILE=y").
+
+Pressing Ctrl-P on the console makes the kernel send the pc samples
+between "@P BEGIN <rate> <dropped>" and "@P END", one sample per line:
+    @P <task> <pc>
+This tool maps the pcs to the functions of os.elf and prints, for each
+function, the number of samples, their share and the estimated time. With
+-t the profile is broken down by task.
+
+usage: profile.py [-t] os.elf [console.log]    (stdin if no log is given)
+e.g.:  make PROFILE=y run | tee console.log; tools/profile.py os.elf console.log
+"""
+
+import sys
+from collections import Counter
+
+from elf import Elf
+
+IDLE_TASK = 0xffffffff
+
+
+def task_name(task):
+    return 'idle' if task == IDLE_TASK else 'task %d' % task
+
+
+def parse(log):
+    """Return (rate, dropped, samples) of the last dump, samples as (task, pc)."""
+    rate, dropped, samples = 0, 0, []
+    for line in log:
+        pos = line.find('@P ')
+        if pos < 0:
+            continue
+        words = line[pos + 3:].split()
+        if words[:1] == ['BEGIN']:
+            try:
+                rate, dropped = int(words[1]), int(words[2])
+            except (ValueError, IndexError):
+                rate, dropped = 0, 0
+            samples = []
+            continue
+        if words[:1] == ['END']:
+            continue
+        try:
+            samples.append((int(words[0], 16), int(words[1], 16)))
+        except (ValueError, IndexError):
+            continue
+    return rate, dropped, samples
+
+
+def print_profile(title, counts, total, rate):
+    print(title)
+    print('%8s %7s %10s  %s' % ('samples', '%', 'ms', 'function'))
+    for name, n in counts.most_common():
+        ms = '%10.1f' % (n * 1000.0 / rate) if rate else '%10s' % '-'
+        print('%8d %6.2f%% %s  %s' % (n, n * 100.0 / total, ms, name))
+    print()
+
+
+def main():
+    args = sys.argv[1:]
+    by_task = False
+    if args[:1] == ['-t']:
+        by_task = True
+        args = args[1:]
+    if not args:
+        sys.exit(__doc__)
+    elf = Elf(args[0])
+    log = open(args[1], 'r', errors='replace') if len(args) > 1 else sys.stdin
+
+    rate, dropped, samples = parse(log)
+    if not samples:
+        sys.exit('no samples found, press Ctrl-P on the console to dump them')
+
+    names = {}
+    for _, pc in samples:
+        if pc not in names:
+            names[pc] = elf.function_at(pc) or '0x%08x' % pc
+
+    print('%d samples at %d Hz, %d dropped\n' % (len(samples), rate, dropped))
+    print_profile('all tasks', Counter(names[pc] for _, pc in samples), len(samples), rate)
+    if by_task:
+        for task in sorted(set(t for t, _ in samples), key=lambda t: (t == IDLE_TASK, t)):
+            mine = [pc for t, pc in samples if t == task]
+            print_profile(task_name(task), Counter(names[pc] for pc in mine), len(mine), rate)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,157 @@
+#!/usr/bin/env python3
+"""
+Convert the kernel events of RVOS (built with "make TRACE=y") to the Chrome
+trace format, which can be opened with chrome://tracing or
+https://ui.perfetto.dev.
+
+Pressing Ctrl-T on the console makes the kernel send the recorded events
+between "@T BEGIN" and "@T END", one event per line:
+    @T <hart> <mtime high> <mtime low> <cycle> <type> <arg0> <arg1>
+Each hart is shown as a process. The tasks are its threads, with a slice
+for each time they run, and traps, interrupts and syscalls are nested
+slices in them. If os.elf is given, the timer callbacks are named.
+
+usage: trace2json.py [-e os.elf] [console.log]    (stdin if no log is given)
+e.g.:  make TRACE=y run | tee console.log; tools/trace2json.py console.log > trace.json
+"""
+
+import json
+import sys
+
+TIMEBASE_FREQ = 10000000  # CLINT_TIMEBASE_FREQ in platform.h
+
+# event types, keep them in sync with TRACE_* in os.h
+TRACE_SWITCH = 1
+TRACE_TRAP_ENTER = 2
+TRACE_TRAP_EXIT = 3
+TRACE_IRQ_CLAIM = 4
+TRACE_IRQ_COMPLETE = 5
+TRACE_TIMER = 6
+TRACE_SYSCALL_ENTER = 7
+TRACE_SYSCALL_EXIT = 8
+
+IDLE_TASK = 0xffffffff
+
+INTERRUPTS = {3: 'software interrupt', 7: 'timer interrupt', 11: 'external interrupt'}
+EXCEPTIONS = {8: 'ecall from U-mode', 11: 'ecall from M-mode'}
+
+
+def trap_name(cause):
+    if cause & 0x80000000:
+        return INTERRUPTS.get(cause & 0xfff, 'interrupt %d' % (cause & 0xfff))
+    return EXCEPTIONS.get(cause & 0xfff, 'exception %d' % (cause & 0xfff))
+
+
+def task_name(task):
+    return 'idle' if task == IDLE_TASK else 'task %d' % task
+
+
+def parse(log):
+    """Return the events of the last dump as (hart, mtime, cycle, type, arg0, arg1)."""
+    events = []
+    for line in log:
+        pos = line.find('@T ')
+        if pos < 0:
+            continue
+        words = line[pos + 3:].split()
+        if words[:1] == ['BEGIN']:
+            events = []
+            continue
+        if words[:1] == ['END']:
+            continue
+        try:
+            w = [int(x, 16) for x in words]
+            events.append((w[0], (w[1] << 32) | w[2], w[3], w[4], w[5], w[6]))
+        except (ValueError, IndexError):
+            continue
+    return events
+
+
+def convert(events, elf=None):
+    out = []
+    # per hart: running task and the categories of the slices open in it
+    task = {}
+    stack = {}
+
+    def us(mtime):
+        return mtime * 1000000 / TIMEBASE_FREQ
+
+    def begin(hart, ts, name, cat, args=None):
+        stack[hart].append(cat)
+        e = {'ph': 'B', 'pid': hart, 'tid': task[hart], 'ts': ts, 'name': name, 'cat': cat}
+        if args:
+            e['args'] = args
+        out.append(e)
+
+    def end(hart, ts):
+        if stack[hart]:
+            stack[hart].pop()
+            out.append({'ph': 'E', 'pid': hart, 'tid': task[hart], 'ts': ts})
+
+    threads = set()
+    for hart, mtime, cycle, kind, arg0, arg1 in sorted(events, key=lambda e: (e[1], e[0])):
+        ts = us(mtime)
+        if hart not in task:
+            # the running task is unknown until the first switch
+            task[hart] = IDLE_TASK if kind != TRACE_SWITCH else arg0
+            stack[hart] = []
+        threads.add((hart, task[hart]))
+
+        if kind == TRACE_SWITCH:
+            # the slices of the previous task end with the switch
+            while stack[hart]:
+                end(hart, ts)
+            task[hart] = arg1
+            threads.add((hart, arg1))
+            begin(hart, ts, task_name(arg1), 'task')
+        elif kind == TRACE_TRAP_ENTER:
+            begin(hart, ts, trap_name(arg0), 'trap', {'epc': '0x%08x' % arg1, 'cycle': cycle})
+        elif kind == TRACE_TRAP_EXIT:
+            # close everything nested in the trap, then the trap itself
+            while stack[hart] and stack[hart][-1] != 'task':
+                cat = stack[hart][-1]
+                end(hart, ts)
+                if cat == 'trap':
+                    break
+        elif kind == TRACE_IRQ_CLAIM:
+            begin(hart, ts, 'irq %d' % arg0, 'irq')
+        elif kind == TRACE_IRQ_COMPLETE:
+            if stack[hart][-1:] == ['irq']:
+                end(hart, ts)
+        elif kind == TRACE_SYSCALL_ENTER:
+            begin(hart, ts, 'syscall %d' % arg0, 'syscall', {'a0': '0x%08x' % arg1})
+        elif kind == TRACE_SYSCALL_EXIT:
+            if stack[hart][-1:] == ['syscall']:
+                end(hart, ts)
+        elif kind == TRACE_TIMER:
+            if arg1:
+                name = (elf.function_at(arg1) if elf else None) or '0x%08x' % arg1
+                name = 'timer ' + name
+            else:
+                name = 'tick'
+            out.append({'ph': 'i', 's': 't', 'pid': hart, 'tid': task[hart], 'ts': ts,
+                        'name': name, 'cat': 'timer', 'args': {'tick': arg0}})
+
+    for hart in stack:
+        out.append({'ph': 'M', 'pid': hart, 'name': 'process_name', 'args': {'name': 'hart %d' % hart}})
+    for hart, t in threads:
+        out.append({'ph': 'M', 'pid': hart, 'tid': t, 'name': 'thread_name', 'args': {'name': task_name(t)}})
+    return out
+
+
+def main():
+    args = sys.argv[1:]
+    elf = None
+    if args[:1] == ['-e']:
+        if len(args) < 2:
+            sys.exit(__doc__)
+        from elf import Elf
+        elf = Elf(args[1])
+        args = args[2:]
+    log = open(args[0], 'r', errors='replace') if args else sys.stdin
+    json.dump({'traceEvents': convert(parse(log), elf), 'displayTimeUnit': 'ns'}, sys.stdout)
+    sys.stdout.write('\n')
+
+
+if __name__ == '__main__':
+    main()
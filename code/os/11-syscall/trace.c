@@ -0,0 +1,77 @@
+#include "os.h"
+
+/*
+ * Kernel event tracer.
+ *
+ * The static tracepoints (see trace() in os.h) record events, stamped with
+ * mtime and the cycle counter, in a fixed-size ring of each hart. The ring
+ * works as a flight recorder: the newest events overwrite the oldest ones.
+ * All the tracepoints are in interrupt context (trap handler, scheduler),
+ * so each ring has only one writer at a time and needs no lock.
+ *
+ * trace_dump() sends the recorded events over the UART, from the oldest to
+ * the newest, as lines of hex words between "@T BEGIN" and "@T END":
+ * 	@T <hart> <mtime high> <mtime low> <cycle> <type> <arg0> <arg1>
+ * Pressing Ctrl-T on the console dumps the events, and
+ * tools/trace2json.py converts them to the Chrome trace format, which can
+ * be opened with chrome://tracing or https://ui.perfetto.dev.
+ */
+#define TRACE_EVENTS 512
+
+struct trace_event {
+	uint64_t mtime;
+	uint32_t cycle;
+	uint32_t type;
+	reg_t arg0;
+	reg_t arg1;
+};
+
+struct trace_buf {
+	struct trace_event events[TRACE_EVENTS];
+	uint32_t next;
+};
+
+static struct trace_buf trace_bufs[MAXNUM_CPU];
+static volatile int trace_on = 1;
+
+void trace_record(int type, reg_t arg0, reg_t arg1)
+{
+	if (!trace_on) {
+		return;
+	}
+
+	struct trace_buf *tb = &trace_bufs[r_tp()];
+	struct trace_event *e = &tb->events[tb->next % TRACE_EVENTS];
+	e->mtime = get_mtime();
+	e->cycle = r_cycle();
+	e->type = type;
+	e->arg0 = arg0;
+	e->arg1 = arg1;
+	tb->next++;
+}
+
+/*
+ * DESCRIPTION
+ * 	Send all the recorded events over the UART and clear the rings.
+ * 	Tracing is paused while dumping. Called by kernel tasks.
+ */
+void trace_dump(void)
+{
+	trace_on = 0;
+
+	printf("@T BEGIN\n");
+	for (int hart = 0; hart < MAXNUM_CPU; hart++) {
+		struct trace_buf *tb = &trace_bufs[hart];
+		uint32_t first = tb->next > TRACE_EVENTS ? tb->next - TRACE_EVENTS : 0;
+		for (uint32_t i = first; i < tb->next; i++) {
+			struct trace_event *e = &tb->events[i % TRACE_EVENTS];
+			printf("@T %d %x %x %x %x %x %x\n", hart,
+			       (uint32_t)(e->mtime >> 32), (uint32_t)e->mtime,
+			       e->cycle, e->type, e->arg0, e->arg1);
+		}
+		tb->next = 0;
+	}
+	printf("@T END\n");
+
+	trace_on = 1;
+}
@@ -1,10 +1,10 @@
 #include "os.h"
 
 extern void trap_vector(void);
-extern void uart_isr(void);
 extern void timer_handler(void);
 extern void schedule(void);
 extern void do_syscall(struct context *cxt);
+extern void irq_dispatch(int irq);
 
 void trap_init()
 {
@@ -18,14 +18,11 @@ void external_interrupt_handler()
 {
 	int irq = plic_claim();
 
-	if (irq == UART0_IRQ){
-      		uart_isr();
-	} else if (irq) {
-		printf("unexpected interrupt irq = %d\n", irq);
-	}
-	
 	if (irq) {
+		trace(TRACE_IRQ_CLAIM, irq, 0);
+		irq_dispatch(irq);
 		plic_complete(irq);
+		trace(TRACE_IRQ_COMPLETE, irq, 0);
 	}
 }
 
@@ -33,12 +30,18 @@ reg_t trap_handler(reg_t epc, reg_t cause, struct context *cxt)
 {
 	reg_t return_pc = epc;
 	reg_t cause_code = cause & 0xfff;
-	
+
+	/*
+	 * If the trap ends up switching to another task, there is no
+	 * TRACE_TRAP_EXIT but a TRACE_SWITCH.
+	 */
+	trace(TRACE_TRAP_ENTER, cause, epc);
+
 	if (cause & 0x80000000) {
 		/* Asynchronous trap - interrupt */
 		switch (cause_code) {
 		case 3:
-			uart_puts("software interruption!\n");
+			pr_debug(TRAP, "software interruption!\n");
 			/*
 			 * acknowledge the software interrupt by clearing
     			 * the MSIP bit in mip.
@@ -50,32 +53,46 @@ reg_t trap_handler(reg_t epc, reg_t cause, struct context *cxt)
 
 			break;
 		case 7:
-			uart_puts("timer interruption!\n");
+			pr_debug(TRAP, "timer interruption!\n");
 			timer_handler();
 			break;
 		case 11:
-			uart_puts("external interruption!\n");
+			pr_debug(TRAP, "external interruption!\n");
 			external_interrupt_handler();
 			break;
 		default:
-			uart_puts("unknown async exception!\n");
+			pr_err(TRAP, "unknown async exception!\n");
 			break;
 		}
 	} else {
 		/* Synchronous trap - exception */
-		printf("Sync exceptions!, code = %d\n", cause_code);
+		pr_debug(TRAP, "Sync exceptions!, code = %d\n", cause_code);
 		switch (cause_code) {
 		case 8:
-			uart_puts("System call from U-mode!\n");
+			pr_debug(TRAP, "System call from U-mode!\n");
 			do_syscall(cxt);
 			return_pc += 4;
 			break;
+#ifdef CONFIG_PMP_GUARD
+		case 5:
+		case 7:
+			/* load/store access fault in the guard region of the stack */
+			if (stack_guard_hit(r_csr(mtval))) {
+				pr_err(TRAP, "task %d: stack overflow! epc = 0x%x, addr = 0x%x\n",
+				       task_current(), epc, r_csr(mtval));
+				panic("Stack overflow!");
+			}
+			panic("OOPS! What can I do!");
+			break;
+#endif
 		default:
 			panic("OOPS! What can I do!");
 			//return_pc += 4;
 		}
 	}
 
+	trace(TRACE_TRAP_EXIT, cause, return_pc);
+
 	return return_pc;
 }
 
@@ -0,0 +1,267 @@
+#include "os.h"
+#include "user_api.h"
+
+/*
+ * Trap round-trip and IPC microbenchmarks, built when TRAP_BENCH=y, see
+ * trapbench.sh for how to run them.
+ *
+ * A user task measures with rdcycle the cycles from before to after each
+ * of the following, TRAP_BENCH_RUNS times:
+ * - ecall:  an empty system call,
+ * - gethid: the gethid() system call,
+ * - yield:  the yield() system call, which raises a software interrupt
+ *           by task_yield(), through schedule(),
+ * - timer:  a timer interrupt, raised by setting mtimecmp to 0, through
+ *           timer_handler() and schedule(),
+ * - plic:   an external interrupt, raised by enabling the transmit
+ *           interrupt of the idle UART, through the PLIC and uart_isr().
+ * - ipc:    a round trip of ipc_call() to a server task, which is waiting
+ *           in ipc_reply_wait(), see ipc.c.
+ * The task is the only one ready to run, the others are blocked, so the
+ * interrupts switch back to it at once. Each result is a line of key=value pairs:
+ * 	TRAP BENCH name=<name> runs=<n> min=<c> median=<c> p99=<c> max=<c>
+ *
+ * Then it measures the throughput of IPC between two tasks, sending
+ * TRAP_BENCH_MSGS messages to a consumer task, which is blocked till then:
+ * - mq:      by a message queue, copying, see mq.c,
+ * - mq_zc:   by a message queue, zero-copy,
+ * - pipe:    by a pipe, writing and reading TRAP_BENCH_MSG_SIZE bytes at a
+ *            time, see pipe.h.
+ * Each result is a line of
+ * 	TRAP BENCH name=<name> msgs=<n> us=<t> msgs/s=<r>
+ * Only hart 0 runs the tasks, so there is no cross-hart case.
+ */
+#define TRAP_BENCH_RUNS 10000
+#define TRAP_BENCH_WARMUP 100
+
+static uint32_t samples[TRAP_BENCH_RUNS];
+
+/* shell sort, the samples are too many for an insertion sort */
+static void sort(uint32_t *a, int n)
+{
+	for (int gap = n / 2; gap > 0; gap /= 2) {
+		for (int i = gap; i < n; i++) {
+			uint32_t x = a[i];
+			int j = i;
+			while (j >= gap && a[j - gap] > x) {
+				a[j] = a[j - gap];
+				j -= gap;
+			}
+			a[j] = x;
+		}
+	}
+}
+
+static void report(char *name)
+{
+	int n = TRAP_BENCH_RUNS;
+
+	sort(samples, n);
+	printf("TRAP BENCH name=%s runs=%d min=%u median=%u p99=%u max=%u\n",
+	       name, n, samples[0], samples[n / 2], samples[n - n / 100 - 1],
+	       samples[n - 1]);
+}
+
+static void bench_ecall(int i)
+{
+	uint32_t start = r_cycle();
+	nop();
+	samples[i] = r_cycle() - start;
+}
+
+static void bench_gethid(int i)
+{
+	unsigned int hid;
+	uint32_t start = r_cycle();
+	gethid(&hid);
+	samples[i] = r_cycle() - start;
+}
+
+static void bench_yield(int i)
+{
+	uint32_t start = r_cycle();
+	yield();
+	samples[i] = r_cycle() - start;
+}
+
+static void bench_timer(int i)
+{
+	/* mtimecmp <= mtime raises the interrupt at once */
+	volatile uint32_t *mtimecmp = (volatile uint32_t *)CLINT_MTIMECMP(r_tp());
+	uint32_t start = r_cycle();
+	mtimecmp[1] = 0;
+	mtimecmp[0] = 0;
+	samples[i] = r_cycle() - start;
+}
+
+static void bench_plic(int i)
+{
+	/* uart_isr() disables the interrupt again as it has nothing to send */
+	while (uart_tx_pending());
+	uint32_t start = r_cycle();
+	uart_irq_raise();
+	samples[i] = r_cycle() - start;
+}
+
+/* the server echoes the calls, it publishes its id before the first wait */
+static int server_id = -1;
+
+static void server_task(void)
+{
+	struct ipc_msg msg;
+	int client = -1;
+
+	server_id = getpid();
+	while (1) {
+		client = ipc_reply_wait(client, &msg);
+	}
+}
+
+static void bench_ipc(int i)
+{
+	struct ipc_msg msg = { { i, 1, 2, 3, 4, 5 } };
+	uint32_t start = r_cycle();
+	ipc_call(server_id, &msg);
+	samples[i] = r_cycle() - start;
+}
+
+static void run(char *name, void (*bench)(int i))
+{
+	for (int i = 0; i < TRAP_BENCH_WARMUP; i++) {
+		bench(0);
+	}
+	for (int i = 0; i < TRAP_BENCH_RUNS; i++) {
+		bench(i);
+	}
+	report(name);
+}
+
+#define TRAP_BENCH_MSGS 10000
+#define TRAP_BENCH_MSG_SIZE 32
+#define TRAP_BENCH_MQ_DEPTH 8
+
+#define TRAP_BENCH_PIPE_SIZE 256
+
+/* the consumer waits for the queue, and tells when it got all messages */
+static int bench_mq = -1;
+static struct pipe *bench_pipe;
+static int bench_done = 0;
+
+static void wait_for(int *p, int old)
+{
+	while (__atomic_load_n(p, __ATOMIC_ACQUIRE) == old) {
+		futex_wait(p, old);
+	}
+}
+
+static void signal(int *p, int val)
+{
+	__atomic_store_n(p, val, __ATOMIC_RELEASE);
+	futex_wake(p, 1);
+}
+
+static void consumer_task(void)
+{
+	char buf[TRAP_BENCH_MSG_SIZE];
+
+	wait_for(&bench_mq, -1);
+	for (int i = 0; i < TRAP_BENCH_MSGS; i++) {
+		mq_receive(bench_mq, buf);
+	}
+	signal(&bench_done, 1);
+
+	for (int i = 0; i < TRAP_BENCH_MSGS; i++) {
+		mq_free(bench_mq, mq_receive(bench_mq, NULL));
+	}
+	signal(&bench_done, 2);
+
+	for (int i = 0; i < TRAP_BENCH_MSGS; i++) {
+		for (int n = 0; n < TRAP_BENCH_MSG_SIZE; ) {
+			int ret = pipe_read(bench_pipe, buf + n,
+					    TRAP_BENCH_MSG_SIZE - n);
+			if (ret < 0) {
+				exit(-1);
+			}
+			n += ret;
+		}
+	}
+	signal(&bench_done, 3);
+
+	exit(0);
+}
+
+static void report_ipc(char *name, uint64_t start)
+{
+	/* mtime ticks are 100ns, count in 10us to keep the rate in 32 bits */
+	uint32_t ticks = vdso_get_time() - start;
+	uint32_t units = ticks / 100;
+	if (units == 0) {
+		units = 1;
+	}
+	printf("TRAP BENCH name=%s msgs=%d us=%u msgs/s=%u\n", name,
+	       TRAP_BENCH_MSGS, ticks / 10, TRAP_BENCH_MSGS * 100000 / units);
+}
+
+static void run_ipc(void)
+{
+	char msg[TRAP_BENCH_MSG_SIZE] = { 0 };
+	uint64_t start;
+
+	int mq = mq_create(TRAP_BENCH_MQ_DEPTH, TRAP_BENCH_MSG_SIZE);
+	bench_pipe = pipe_create(TRAP_BENCH_PIPE_SIZE);
+	if (mq < 0 || bench_pipe == NULL) {
+		printf("TRAP BENCH: mq_create() or pipe_create() failed\n");
+		return;
+	}
+
+	start = vdso_get_time();
+	signal(&bench_mq, mq);
+	for (int i = 0; i < TRAP_BENCH_MSGS; i++) {
+		mq_send(mq, msg);
+	}
+	wait_for(&bench_done, 0);
+	report_ipc("mq", start);
+
+	start = vdso_get_time();
+	for (int i = 0; i < TRAP_BENCH_MSGS; i++) {
+		char *buf = mq_alloc(mq);
+		buf[0] = i;
+		mq_send(mq, buf);
+	}
+	wait_for(&bench_done, 1);
+	report_ipc("mq_zc", start);
+
+	start = vdso_get_time();
+	for (int i = 0; i < TRAP_BENCH_MSGS; i++) {
+		pipe_write(bench_pipe, msg, TRAP_BENCH_MSG_SIZE);
+	}
+	wait_for(&bench_done, 2);
+	report_ipc("pipe", start);
+
+	mq_destroy(mq);
+	pipe_destroy(bench_pipe);
+}
+
+static void trap_bench_task(void)
+{
+	/* let the kernel tasks, the consumer and the server go to sleep first */
+	yield();
+
+	run("ecall", bench_ecall);
+	run("gethid", bench_gethid);
+	run("yield", bench_yield);
+	run("timer", bench_timer);
+	run("plic", bench_plic);
+	run("ipc", bench_ipc);
+	run_ipc();
+	printf("TRAP BENCH: done\n");
+
+	exit(0);
+}
+
+void trap_bench_start(void)
+{
+	task_create(trap_bench_task);
+	task_create(consumer_task);
+	task_create(server_task);
+}
@@ -0,0 +1,25 @@
+#!/bin/sh
+#
+# Run the trap round-trip and IPC microbenchmarks, the kernel must be built
+# with "make TRAP_BENCH=y". The output of the guest is saved in
+# trapbench.log, and the results are printed as lines of key=value pairs.
+#
+# usage: ./trapbench.sh [qemu]
+
+QEMU=${1:-qemu-system-riscv32}
+LOG=trapbench.log
+
+rm -f ${LOG}
+
+${QEMU} -display none -smp 1 -machine virt -bios none -monitor none \
+	-serial file:${LOG} -kernel os.elf &
+QEMU_PID=$!
+
+for i in $(seq 600); do
+	grep -q "TRAP BENCH: done" ${LOG} 2>/dev/null && break
+	sleep 0.1
+done
+
+kill ${QEMU_PID} 2>/dev/null
+grep -q "TRAP BENCH: done" ${LOG} || echo "timeout waiting for the benchmarks"
+grep "TRAP BENCH name=" ${LOG}
@@ -0,0 +1,197 @@
+#include "os.h"
+
+/*
+ * Line discipline of the console.
+ * The characters received by the UART are passed in by tty_receive() from
+ * the bottom half of the UART interrupt handler, and are handed out to the
+ * tasks by tty_read().
+ *
+ * In canonical mode (TTY_ICANON), the input is edited in line_buf, and is
+ * only readable after a whole line is committed by '\n' (or '\r'), or by
+ * Ctrl-D which commits the line without a newline, and which means end of
+ * file on an empty line. Backspace erases the last character of the line.
+ * Otherwise (raw mode), every character is readable at once.
+ * With TTY_ECHO, the input is echoed back to the UART.
+ *
+ * The readable characters are kept in read_buf, read_head is only updated
+ * by tty_receive() and read_tail only by tty_read(), both free-running and
+ * wrapped by TTY_BUF_SIZE.
+ */
+#define TTY_BUF_SIZE 256
+#define TTY_LINE_MAX 128
+
+#define CTRL_D 0x04
+#define CTRL_P 0x10
+#define CTRL_S 0x13
+#define CTRL_T 0x14
+#define BACKSPACE 0x08
+#define DELETE 0x7f
+
+static char read_buf[TTY_BUF_SIZE];
+static volatile uint32_t read_head = 0;
+static volatile uint32_t read_tail = 0;
+
+static char line_buf[TTY_LINE_MAX];
+static int line_len = 0;
+
+/* number of committed Ctrl-D, each of them makes a read return 0 */
+static volatile int eof_count = 0;
+
+static int tty_mode = TTY_ICANON | TTY_ECHO;
+
+/* tasks waiting for input */
+static struct wait_queue readers;
+
+static void tty_echo(char c)
+{
+	if (tty_mode & TTY_ECHO) {
+		uart_putc(c);
+	}
+}
+
+static void tty_commit(char *buf, int len)
+{
+	for (int i = 0; i < len; i++) {
+		if (read_head - read_tail >= TTY_BUF_SIZE) {
+			/* drop the rest if nobody reads */
+			break;
+		}
+		read_buf[read_head % TTY_BUF_SIZE] = buf[i];
+		read_head++;
+	}
+}
+
+/*
+ * DESCRIPTION
+ * 	Pass a character received by the UART to the line discipline.
+ * 	Called by the kernel task serving the UART bottom half.
+ */
+void tty_receive(char c)
+{
+#ifdef CONFIG_TRACE
+	/* Ctrl-T dumps the kernel events, see trace.c */
+	if (c == CTRL_T) {
+		trace_dump();
+		return;
+	}
+#endif
+
+#ifdef CONFIG_PROFILE
+	/* Ctrl-P dumps the samples of the profiler, see profile.c */
+	if (c == CTRL_P) {
+		profile_dump();
+		return;
+	}
+#endif
+
+#ifdef CONFIG_SCHEDSTAT
+	/* Ctrl-S prints the scheduler statistics, see schedstat.c */
+	if (c == CTRL_S) {
+		schedstat_show();
+		return;
+	}
+#endif
+
+	spin_lock();
+
+	if (!(tty_mode & TTY_ICANON)) {
+		tty_commit(&c, 1);
+		tty_echo(c);
+		wake_up(&readers);
+		spin_unlock();
+		return;
+	}
+
+	switch (c) {
+	case BACKSPACE:
+	case DELETE:
+		if (line_len > 0) {
+			line_len--;
+			tty_echo('\b');
+			tty_echo(' ');
+			tty_echo('\b');
+		}
+		break;
+	case CTRL_D:
+		/* Ctrl-D on an empty line means end of file */
+		if (line_len == 0) {
+			eof_count++;
+		}
+		tty_commit(line_buf, line_len);
+		line_len = 0;
+		wake_up(&readers);
+		break;
+	case '\r':
+	case '\n':
+		line_buf[line_len++] = '\n';
+		tty_commit(line_buf, line_len);
+		line_len = 0;
+		tty_echo('\n');
+		wake_up(&readers);
+		break;
+	default:
+		/* keep the last byte of line_buf for '\n' */
+		if (line_len < TTY_LINE_MAX - 1) {
+			line_buf[line_len++] = c;
+			tty_echo(c);
+		}
+		break;
+	}
+
+	spin_unlock();
+}
+
+/*
+ * DESCRIPTION
+ * 	Take at most n readable characters. In canonical mode, a read stops
+ * 	at the end of a line.
+ * 	Called in interrupt context, e.g. by the read() system call.
+ * RETURN VALUE
+ * 	number of the characters read, 0 for end of file (Ctrl-D).
+ * 	-1: if nothing is readable, the caller may wait on tty_wait_queue().
+ */
+int tty_read(char *buf, int n)
+{
+	if (read_head == read_tail) {
+		if (eof_count > 0) {
+			eof_count--;
+			return 0;
+		}
+		return -1;
+	}
+
+	int i = 0;
+	while (i < n && read_tail != read_head) {
+		char c = read_buf[read_tail % TTY_BUF_SIZE];
+		read_tail++;
+		buf[i++] = c;
+		if (c == '\n' && (tty_mode & TTY_ICANON)) {
+			break;
+		}
+	}
+	return i;
+}
+
+/* if a tty_read() would not return -1, called in interrupt context */
+int tty_poll(void)
+{
+	return read_head != read_tail || eof_count > 0;
+}
+
+struct wait_queue *tty_wait_queue(void)
+{
+	return &readers;
+}
+
+/*
+ * DESCRIPTION
+ * 	Set the mode of the line discipline, TTY_ICANON and/or TTY_ECHO.
+ * 	The line being edited is dropped when the mode changes.
+ */
+void tty_set_mode(int mode)
+{
+	spin_lock();
+	tty_mode = mode;
+	line_len = 0;
+	spin_unlock();
+}
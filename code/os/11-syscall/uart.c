@@ -58,14 +58,102 @@
  * LSR BIT 5:
  * 0 = transmit holding register is full. 16550 will not accept any data for transmission.
  * 1 = transmitter hold register (or FIFO) is empty. CPU can load the next character.
+ * LSR BIT 6:
+ * 1 = both the transmit FIFO and the transmit shift register are empty.
  * ......
  */
 #define LSR_RX_READY (1 << 0)
 #define LSR_TX_IDLE  (1 << 5)
+#define LSR_TX_EMPTY (1 << 6)
+
+/*
+ * FIFO CONTROL REGISTER (FCR)
+ * FCR BIT 0: 1 = enable the transmit and receive FIFOs
+ * FCR BIT 1: 1 = clear the receive FIFO
+ * FCR BIT 2: 1 = clear the transmit FIFO
+ * FCR BIT 6-7: receive FIFO trigger level, the receive data available
+ * interrupt is raised once so many characters are in the receive FIFO.
+ * 00 = 1 byte, 01 = 4 bytes, 10 = 8 bytes, 11 = 14 bytes.
+ * If fewer characters have arrived and no more comes in 4 character times,
+ * a character timeout interrupt is raised instead.
+ */
+#define FCR_FIFO_ENABLE (1 << 0)
+#define FCR_RX_CLEAR    (1 << 1)
+#define FCR_TX_CLEAR    (1 << 2)
+#define FCR_RX_TRIGGER_1  (0 << 6)
+#define FCR_RX_TRIGGER_4  (1 << 6)
+#define FCR_RX_TRIGGER_8  (2 << 6)
+#define FCR_RX_TRIGGER_14 (3 << 6)
+
+/*
+ * Receive FIFO trigger level in bytes, 1, 4, 8 or 14. A higher level means
+ * fewer interrupts for a burst of input, at the cost of a later interrupt
+ * (character timeout) for the last few characters.
+ */
+#ifndef UART_RX_TRIGGER
+#define UART_RX_TRIGGER 8
+#endif
+
+/*
+ * INTERRUPT ENABLE REGISTER (IER)
+ * IER BIT 0: 1 = enable the receive data available interrupt
+ * IER BIT 1: 1 = enable the transmit holding register empty interrupt
+ */
+#define IER_RX_ENABLE (1 << 0)
+#define IER_TX_ENABLE (1 << 1)
 
 #define uart_read_reg(reg) (*(UART_REG(reg)))
 #define uart_write_reg(reg, v) (*(UART_REG(reg)) = (v))
 
+void uart_isr(void *arg);
+static void uart_rx_work(void *arg);
+
+/*
+ * The characters received by uart_isr() are saved in rx_buf, and passed to
+ * the line discipline (tty.c) later by the bottom half rx_work, which may
+ * echo them back, so the interrupt handler never waits for the transmitter.
+ * rx_head is only updated by uart_isr() and rx_tail only by rx_work, so no
+ * lock is needed, they are free-running and wrapped by UART_RX_BUF_SIZE.
+ */
+#define UART_RX_BUF_SIZE 256
+static char rx_buf[UART_RX_BUF_SIZE];
+static volatile uint32_t rx_head = 0;
+static volatile uint32_t rx_tail = 0;
+static struct work rx_work;
+
+/* total of the characters received */
+static volatile uint32_t rx_total = 0;
+
+/*
+ * The characters to be sent are queued in tx_buf by the writers, and moved
+ * to the UART by uart_isr() when the transmitter holding register is empty,
+ * so the writers never wait for the transmitter unless tx_buf is full.
+ *
+ * There can be many writers: tasks in user mode (which can't disable the
+ * interrupts), kernel tasks and interrupt handlers, so a writer reserves a
+ * slot by increasing tx_head atomically and then fills it. Each slot holds
+ * the character with TX_SLOT_READY set once it is filled, uart_isr() (the
+ * only reader) stops at a slot which is reserved but not filled yet, and the
+ * writer kicks the transmitter again after filling it.
+ * tx_head/tx_tail are free-running and wrapped by UART_TX_BUF_SIZE.
+ */
+#define UART_TX_BUF_SIZE 1024
+#define UART_TX_FIFO_SIZE 16
+#define TX_SLOT_READY (1 << 8)
+static volatile uint16_t tx_buf[UART_TX_BUF_SIZE];
+static volatile uint32_t tx_head = 0;
+static volatile uint32_t tx_tail = 0;
+
+/*
+ * A blocking writer waits at most UART_TX_SPIN loops for the reader to
+ * make room. If the reader doesn't move in that time, it can't run, e.g.
+ * the writer is an interrupt handler, then the character is written to
+ * the UART directly. tx_stall_tail remembers where the reader stopped so
+ * that the following characters don't wait again.
+ */
+#define UART_TX_SPIN 100000
+static volatile uint32_t tx_stall_tail = -1;
+
 void uart_init()
 {
 	/* disable interrupts. */
@@ -104,22 +192,209 @@ void uart_init()
 	uart_write_reg(LCR, lcr | (3 << 0));
 
 	/*
-	 * enable receive interrupts.
+	 * Enable and clear the 16-byte FIFOs, so that each receive interrupt
+	 * takes a burst of characters and each transmit interrupt can send
+	 * UART_TX_FIFO_SIZE characters.
+	 */
+	uint8_t fcr = FCR_FIFO_ENABLE | FCR_RX_CLEAR | FCR_TX_CLEAR;
+	switch (UART_RX_TRIGGER) {
+	case 1:
+		fcr |= FCR_RX_TRIGGER_1;
+		break;
+	case 4:
+		fcr |= FCR_RX_TRIGGER_4;
+		break;
+	case 14:
+		fcr |= FCR_RX_TRIGGER_14;
+		break;
+	default:
+		fcr |= FCR_RX_TRIGGER_8;
+		break;
+	}
+	uart_write_reg(FCR, fcr);
+
+	/*
+	 * enable receive interrupts, the transmit interrupts are enabled only
+	 * when there are characters to be sent in tx_buf.
 	 */
 	uint8_t ier = uart_read_reg(IER);
-	uart_write_reg(IER, ier | (1 << 0));
+	uart_write_reg(IER, ier | IER_RX_ENABLE);
+
+	work_init(&rx_work, uart_rx_work, NULL);
+	request_irq(UART0_IRQ, uart_isr, NULL, 1);
 }
 
-int uart_putc(char ch)
+/*
+ * Move the characters in tx_buf to the UART. The transmit interrupt means
+ * the transmit FIFO is empty, so a full FIFO's worth can be written in a
+ * burst without checking LSR for each character. The transmit interrupt is
+ * disabled when nothing more can be sent.
+ * Called by uart_isr() in interrupt context.
+ */
+static void uart_tx_fill(void)
+{
+	if ((uart_read_reg(LSR) & LSR_TX_IDLE) == 0) {
+		/* wait for the next transmit interrupt */
+		return;
+	}
+
+	for (int n = 0; n < UART_TX_FIFO_SIZE; n++) {
+		if (tx_tail == tx_head) {
+			break;
+		}
+		uint16_t slot = tx_buf[tx_tail % UART_TX_BUF_SIZE];
+		if (!(slot & TX_SLOT_READY)) {
+			break;
+		}
+		uart_write_reg(THR, (char)slot);
+		tx_buf[tx_tail % UART_TX_BUF_SIZE] = 0;
+		tx_tail++;
+	}
+
+	/*
+	 * tx_buf is empty or the next slot is being filled, whose writer will
+	 * kick us again.
+	 */
+	if (tx_tail == tx_head ||
+	    !(tx_buf[tx_tail % UART_TX_BUF_SIZE] & TX_SLOT_READY)) {
+		uart_write_reg(IER, uart_read_reg(IER) & ~IER_TX_ENABLE);
+	}
+}
+
+/*
+ * Enable the transmit interrupt, it is raised at once if the transmitter
+ * holding register is empty.
+ */
+static inline void uart_tx_kick(void)
+{
+	uart_write_reg(IER, uart_read_reg(IER) | IER_TX_ENABLE);
+}
+
+/* reserve a slot in tx_buf and fill it, return -1 if tx_buf is full */
+static int uart_tx_queue(char ch)
+{
+	uint32_t head = tx_head;
+	do {
+		if (head - tx_tail >= UART_TX_BUF_SIZE) {
+			return -1;
+		}
+	} while (!__atomic_compare_exchange_n(&tx_head, &head, head + 1, 0,
+					      __ATOMIC_ACQ_REL, __ATOMIC_RELAXED));
+
+	tx_buf[head % UART_TX_BUF_SIZE] = TX_SLOT_READY | (uint8_t)ch;
+	return 0;
+}
+
+/* write a character to the UART directly, bypassing tx_buf */
+static void uart_putc_sync(char ch)
 {
 	while ((uart_read_reg(LSR) & LSR_TX_IDLE) == 0);
-	return uart_write_reg(THR, ch);
+	uart_write_reg(THR, ch);
+}
+
+/*
+ * DESCRIPTION
+ * 	Queue len characters in buf to be sent by the UART.
+ * 	- flags: UART_NONBLOCK, return at once if tx_buf is full. Otherwise
+ * 	  wait till all the characters are queued.
+ * RETURN VALUE
+ * 	the number of characters queued, which is less than len only in the
+ * 	non-blocking mode.
+ */
+int uart_write(const char *buf, int len, int flags)
+{
+	int i;
+	for (i = 0; i < len; i++) {
+		if (uart_tx_queue(buf[i]) == 0) {
+			continue;
+		}
+		if (flags & UART_NONBLOCK) {
+			break;
+		}
+
+		/* tx_buf is full, let uart_isr() drain it and try again */
+		uart_tx_kick();
+		int queued = 0;
+		uint32_t tail = tx_tail;
+		if (tail != tx_stall_tail) {
+			for (int spin = 0; spin < UART_TX_SPIN; spin++) {
+				if (uart_tx_queue(buf[i]) == 0) {
+					queued = 1;
+					break;
+				}
+				if (tx_tail != tail) {
+					tail = tx_tail;
+					spin = 0;
+				}
+			}
+		}
+		if (!queued) {
+			tx_stall_tail = tail;
+			uart_putc_sync(buf[i]);
+		}
+	}
+
+	if (i > 0) {
+		uart_tx_kick();
+	}
+	return i;
+}
+
+int uart_putc(char ch)
+{
+	return uart_write(&ch, 1, 0);
 }
 
 void uart_puts(char *s)
 {
-	while (*s) {
-		uart_putc(*s++);
+	int len = 0;
+	while (s[len]) {
+		len++;
+	}
+	uart_write(s, len, 0);
+}
+
+/* number of the characters queued in tx_buf but not sent yet */
+uint32_t uart_tx_pending(void)
+{
+	return tx_head - tx_tail;
+}
+
+/* if every character queued has left the UART, the FIFO included */
+int uart_tx_done(void)
+{
+	return tx_head == tx_tail && (uart_read_reg(LSR) & LSR_TX_EMPTY);
+}
+
+/*
+ * Raise a UART interrupt, for measuring the cost of an external interrupt,
+ * see trapbench.c. With tx_buf empty, uart_isr() disables it again.
+ */
+void uart_irq_raise(void)
+{
+	uart_tx_kick();
+}
+
+/* total number of the characters received since boot */
+uint32_t uart_rx_count(void)
+{
+	return rx_total;
+}
+
+/*
+ * DESCRIPTION
+ * 	Send all the characters in tx_buf by polling, e.g. before the system
+ * 	stops in panic() with interrupt disabled.
+ */
+void uart_flush(void)
+{
+	while (tx_tail != tx_head) {
+		uint16_t slot = tx_buf[tx_tail % UART_TX_BUF_SIZE];
+		if (slot & TX_SLOT_READY) {
+			uart_putc_sync((char)slot);
+		}
+		tx_buf[tx_tail % UART_TX_BUF_SIZE] = 0;
+		tx_tail++;
 	}
 }
 
@@ -133,17 +408,41 @@ int uart_getc(void)
 }
 
 /*
- * handle a uart interrupt, raised because input has arrived, called from trap.c.
+ * handle a uart interrupt, raised because input has arrived or the
+ * transmitter is ready for more characters, called from irq.c.
+ * Just drain the receive FIFO and leave the rest to rx_work, then refill
+ * the transmit FIFO from tx_buf.
  */
-void uart_isr(void)
+void uart_isr(void *arg)
 {
 	while (1) {
 		int c = uart_getc();
 		if (c == -1) {
 			break;
-		} else {
-			uart_putc((char)c);
-			uart_putc('\n');
 		}
+		rx_total++;
+		/* drop the character if the buffer is full */
+		if (rx_head - rx_tail < UART_RX_BUF_SIZE) {
+			rx_buf[rx_head % UART_RX_BUF_SIZE] = (char)c;
+			rx_head++;
+		}
+	}
+
+	if (rx_head != rx_tail) {
+		queue_work(&rx_work);
+	}
+
+	uart_tx_fill();
+}
+
+/*
+ * bottom half of uart_isr(), run by kworker with interrupt enabled.
+ */
+static void uart_rx_work(void *arg)
+{
+	while (rx_tail != rx_head) {
+		char c = rx_buf[rx_tail % UART_RX_BUF_SIZE];
+		rx_tail++;
+		tty_receive(c);
 	}
 }
@@ -0,0 +1,119 @@
+#include "os.h"
+
+/*
+ * UART throughput benchmark, built when UART_BENCH=y, see uartbench.sh for
+ * how to run it with the UART connected to a pipe on the host.
+ *
+ * TX: send UART_BENCH_BYTES characters, and measure the time until all of
+ * them have left the transmit FIFO.
+ * RX: wait for the host to send UART_BENCH_BYTES characters, and measure
+ * the time from the first one to the last one.
+ * For both, the number of UART interrupts is reported as interrupts per KB.
+ *
+ * UART_BENCH_BYTES is kept small enough that the arithmetic below fits in
+ * 32 bits, RV32 has no 64-bit division without libgcc.
+ */
+#define UART_BENCH_BYTES (64 * 1024)
+#define UART_BENCH_LINE 64
+
+/* stop waiting for the RX data after it has been idle for 2s */
+#define UART_BENCH_RX_IDLE (2 * CLINT_TIMEBASE_FREQ)
+
+static struct wait_queue bench_done;
+
+static void uart_bench_report(char *dir, uint32_t bytes, uint32_t ticks,
+			      uint32_t irqs)
+{
+	/* ticks are 100ns, count in 100us to keep bytes * 10000 in 32 bits */
+	uint32_t units = ticks / 1000;
+	if (units == 0) {
+		units = 1;
+	}
+	uint32_t bps = bytes * 10000 / units;
+	uint32_t kb = bytes / 1024;
+	if (kb == 0) {
+		kb = 1;
+	}
+	uint32_t irqs_per_kb = irqs * 100 / kb;
+
+	printf("UART BENCH %s: bytes=%d us=%d bytes/s=%d irqs=%d irqs/KB=%d.%d%d\n",
+	       dir, bytes, ticks / 10, bps, irqs,
+	       irqs_per_kb / 100, (irqs_per_kb / 10) % 10, irqs_per_kb % 10);
+}
+
+static void uart_bench_tx(void)
+{
+	char line[UART_BENCH_LINE];
+	for (int i = 0; i < UART_BENCH_LINE - 1; i++) {
+		line[i] = 'a' + i % 26;
+	}
+	line[UART_BENCH_LINE - 1] = '\n';
+
+	/* let the output so far go out first */
+	while (!uart_tx_done());
+
+	uint32_t irqs = irq_get_count(UART0_IRQ);
+	uint64_t start = get_mtime();
+
+	for (int n = 0; n < UART_BENCH_BYTES; n += UART_BENCH_LINE) {
+		uart_write(line, UART_BENCH_LINE, 0);
+	}
+	while (!uart_tx_done());
+
+	uint32_t ticks = get_mtime() - start;
+	irqs = irq_get_count(UART0_IRQ) - irqs;
+
+	uart_bench_report("TX", UART_BENCH_BYTES, ticks, irqs);
+}
+
+static void uart_bench_rx(void)
+{
+	tty_set_mode(0);
+
+	printf("UART BENCH RX: ready, send %d bytes\n", UART_BENCH_BYTES);
+
+	uint32_t base = uart_rx_count();
+	while (uart_rx_count() == base);
+
+	uint32_t irqs = irq_get_count(UART0_IRQ);
+	uint64_t start = get_mtime();
+	uint64_t last = start;
+	uint32_t count = uart_rx_count();
+
+	while (count - base < UART_BENCH_BYTES) {
+		uint64_t now = get_mtime();
+		if (uart_rx_count() != count) {
+			count = uart_rx_count();
+			last = now;
+		} else if (now - last > UART_BENCH_RX_IDLE) {
+			break;
+		}
+	}
+
+	uint32_t ticks = last - start;
+	irqs = irq_get_count(UART0_IRQ) - irqs;
+
+	tty_set_mode(TTY_ICANON | TTY_ECHO);
+
+	uart_bench_report("RX", count - base, ticks, irqs);
+}
+
+static void uart_bench_task(void)
+{
+	uart_bench_tx();
+	uart_bench_rx();
+	printf("UART BENCH: done\n");
+
+	/* a kernel task should never return */
+	while (1) {
+		spin_lock();
+		wait_queue_sleep(&bench_done);
+		task_yield();
+		spin_unlock();
+	}
+}
+
+void uart_bench_start(void)
+{
+	ktask_create(uart_bench_task);
+}
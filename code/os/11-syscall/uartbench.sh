@@ -0,0 +1,43 @@
+#!/bin/sh
+#
+# Run the UART throughput benchmark, the kernel must be built with
+# "make UART_BENCH=y". The UART of QEMU is connected to a pair of named
+# pipes, uartbench.in (host -> guest) and uartbench.out (guest -> host),
+# the output of the guest is saved in uartbench.log.
+#
+# usage: ./uartbench.sh [qemu]
+
+QEMU=${1:-qemu-system-riscv32}
+PIPE=uartbench
+BYTES=65536
+
+rm -f ${PIPE}.in ${PIPE}.out ${PIPE}.log
+mkfifo ${PIPE}.in ${PIPE}.out || exit 1
+
+cat ${PIPE}.out > ${PIPE}.log &
+CAT_PID=$!
+
+${QEMU} -nographic -smp 1 -machine virt -bios none -monitor none \
+	-serial pipe:${PIPE} -kernel os.elf &
+QEMU_PID=$!
+
+# wait for the guest
+wait_for()
+{
+	for i in $(seq 600); do
+		grep -q "$1" ${PIPE}.log && return 0
+		sleep 0.1
+	done
+	echo "timeout waiting for: $1"
+	return 1
+}
+
+if wait_for "UART BENCH RX: ready"; then
+	yes "0123456789abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ" | \
+		head -c ${BYTES} > ${PIPE}.in
+	wait_for "UART BENCH: done"
+fi
+
+kill ${QEMU_PID} ${CAT_PID} 2>/dev/null
+grep "UART BENCH" ${PIPE}.log | grep -v "ready"
+rm -f ${PIPE}.in ${PIPE}.out
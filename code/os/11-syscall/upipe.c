@@ -0,0 +1,63 @@
+#include "os.h"
+#include "user_api.h"
+
+/*
+ * The user side of the pipes, see pipe.h. While there is data to read or
+ * room to write, these move it with no system call, and trap only to
+ * sleep on an empty or full pipe, or to wake up the other side sleeping
+ * on one.
+ */
+
+/*
+ * DESCRIPTION
+ * 	Read from a pipe, block till some data is readable.
+ * RETURN VALUE
+ * 	the number of bytes read(> 0)
+ * 	-1: if error occured
+ */
+int pipe_read(struct pipe *p, char *buf, int n)
+{
+	if (n <= 0) {
+		return n == 0 ? 0 : -1;
+	}
+
+	while (1) {
+		int ret = pipe_get(p, buf, n);
+		if (ret > 0) {
+			if (pipe_sleeping(p, PIPE_WRITER)) {
+				pipe_notify(p, PIPE_WRITER);
+			}
+			return ret;
+		}
+		if (pipe_wait(p, PIPE_READER) < 0) {
+			return -1;
+		}
+	}
+}
+
+/*
+ * DESCRIPTION
+ * 	Write to a pipe, block till all the data is written.
+ * RETURN VALUE
+ * 	n
+ * 	-1: if error occured
+ */
+int pipe_write(struct pipe *p, const char *buf, int n)
+{
+	int done = 0;
+
+	while (done < n) {
+		int ret = pipe_put(p, buf + done, n - done);
+		if (ret > 0) {
+			done += ret;
+			if (pipe_sleeping(p, PIPE_READER)) {
+				pipe_notify(p, PIPE_READER);
+			}
+			continue;
+		}
+		if (pipe_wait(p, PIPE_WRITER) < 0) {
+			return -1;
+		}
+	}
+	return n < 0 ? -1 : n;
+}
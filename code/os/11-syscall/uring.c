@@ -0,0 +1,145 @@
+#include "os.h"
+#include "syscall.h"
+
+/*
+ * Syscall rings.
+ *
+ * Each ecall costs a full trap, so a task which makes many system calls
+ * can queue them in the submission queue of a struct uring in its memory,
+ * and run them all with one ring_enter(). The result of each one is
+ * posted to the completion queue with the user_data of its entry.
+ *
+ * The entries are run in order, till the submission queue is empty or the
+ * completion queue is full. Those which block end the batch:
+ * - sleep is completed before the task sleeps, the rest of the entries are
+ *   run by the next ring_enter();
+ * - those which wait by syscall_wait(), e.g. read with no input, mq_send()
+ *   on a full queue or wait_any(), restart ring_enter() once woken up. Their
+ *   entry is still queued and run again, and the entries before it are
+ *   already consumed.
+ * A URING_OP_TIMEOUT entry is completed later by the timer, and a task can
+ * wait for the completions with min_complete. The system calls which can't
+ * be batched, see the ring flag in syscall.h, are completed with -1.
+ */
+static struct wait_queue waiters[MAX_TASKS];
+
+struct uring_timeout {
+	struct uring *ring;
+	reg_t user_data;
+	int task;
+};
+
+/*
+ * post a completion, this routine should be called in interrupt context
+ * (interrupt is disabled)
+ */
+static struct uring_cqe *uring_complete(struct uring *ring, reg_t user_data,
+					reg_t res)
+{
+	if (ring->cq_tail - ring->cq_head >= URING_ENTRIES) {
+		ring->cq_overflow++;
+		return NULL;
+	}
+
+	struct uring_cqe *cqe = &ring->cq[ring->cq_tail % URING_ENTRIES];
+	cqe->user_data = user_data;
+	cqe->res = res;
+	ring->cq_tail++;
+	return cqe;
+}
+
+static void uring_timeout(void *arg)
+{
+	struct uring_timeout *t = (struct uring_timeout *)arg;
+
+	uring_complete(t->ring, t->user_data, 0);
+	wake_up(&waiters[t->task]);
+	kfree(t);
+}
+
+static int uring_timeout_add(struct uring *ring, reg_t user_data,
+			     uint32_t ticks)
+{
+	struct uring_timeout *t = kmalloc(sizeof(struct uring_timeout));
+	if (t == NULL) {
+		return -1;
+	}
+
+	t->ring = ring;
+	t->user_data = user_data;
+	t->task = task_current();
+	if (timer_create(uring_timeout, t, ticks) == NULL) {
+		kfree(t);
+		return -1;
+	}
+	return 0;
+}
+
+/*
+ * DESCRIPTION
+ * 	Run the entries queued in the submission queue of the ring, then wait
+ * 	till there are min_complete completions in its completion queue.
+ * RETURN VALUE
+ * 	the number of completions in the completion queue
+ * 	-1: if error occured
+ */
+int sys_ring_enter(struct uring *ring, uint32_t min_complete)
+{
+	if (ring == NULL || min_complete > URING_ENTRIES) {
+		return -1;
+	}
+
+	while (ring->sq_head != ring->sq_tail) {
+		/* leave the rest in the queue till there is room for them */
+		if (ring->cq_tail - ring->cq_head >= URING_ENTRIES) {
+			break;
+		}
+
+		struct uring_sqe sqe = ring->sq[ring->sq_head % URING_ENTRIES];
+		struct uring_cqe *cqe;
+		reg_t res;
+
+		switch (sqe.op) {
+		case URING_OP_TIMEOUT:
+			ring->sq_head++;
+			if (uring_timeout_add(ring, sqe.user_data, sqe.args[0]) < 0) {
+				uring_complete(ring, sqe.user_data, -1);
+			}
+			break;
+		case SYS_sleep:
+			/*
+			 * complete it before the task sleeps, the task can't
+			 * see it till it runs again
+			 */
+			ring->sq_head++;
+			cqe = uring_complete(ring, sqe.user_data, 0);
+			if (syscall_sleep(sqe.args[0],
+					  ring->cq_tail - ring->cq_head) < 0) {
+				cqe->res = -1;
+			}
+			break;
+		default:
+			if (!syscall_ring_safe(sqe.op)) {
+				/* e.g. ring_enter itself, or futex_wait */
+				ring->sq_head++;
+				uring_complete(ring, sqe.user_data, -1);
+				break;
+			}
+			/*
+			 * a read with no input doesn't return, its entry stays
+			 * in the queue to be run again on the restart
+			 */
+			res = syscall_invoke(sqe.op, sqe.args[0], sqe.args[1],
+					     sqe.args[2]);
+			ring->sq_head++;
+			uring_complete(ring, sqe.user_data, res);
+			break;
+		}
+	}
+
+	if (ring->cq_tail - ring->cq_head < min_complete) {
+		syscall_wait(&waiters[task_current()]);
+	}
+
+	return ring->cq_tail - ring->cq_head;
+}
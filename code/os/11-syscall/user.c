@@ -1,6 +1,7 @@
 #include "os.h"
 
 #include "user_api.h"
+#include "syscall.h"
 
 #define DELAY 4000
 
@@ -31,22 +32,191 @@ void user_task0(void)
 	while (1){
 		uart_puts("Task 0: Running... \n");
 		task_delay(DELAY);
+#if defined(CONFIG_SYSCALL) && defined(CONFIG_PERF)
+		struct perf_stat st;
+		if (!perf_stat(TASK_SELF, &st)) {
+			printf("Task 0: %llu cycles, %llu instructions\n",
+			       st.cycles, st.instret);
+		}
+#endif
 	}
 }
 
 void user_task1(void)
 {
 	uart_puts("Task 1: Created!\n");
+#ifdef CONFIG_SYSCALL
+	/*
+	 * read() blocks the task till a line is input, so the task takes no
+	 * CPU while waiting.
+	 */
+	char line[64];
+	int console = WAIT_TTY;
+	while (1) {
+		/* wait_any() with a timeout, read() alone would block forever */
+		if (wait_any(&console, 1, 30) == 0) {
+			printf("Task 1: no input for 30 ticks\n");
+			continue;
+		}
+		int n = read(0, line, sizeof(line) - 1);
+		if (n < 0) {
+			printf("read() failed, return: %d\n", n);
+			break;
+		}
+		line[n] = 0;
+		printf("Task 1: read %d bytes: %s", n, line);
+		if (n == 0) {
+			printf("<EOF>\n");
+		}
+	}
+#endif
 	while (1) {
 		uart_puts("Task 1: Running... \n");
 		task_delay(DELAY);
 	}
 }
 
+#ifdef CONFIG_SYSCALL
+/*
+ * Task 2 and task 3 add to a counter under a mutex, and yield while they
+ * hold it, so each of them finds it locked and waits in futex_wait().
+ */
+static struct mutex counter_lock = MUTEX_INITIALIZER;
+static int counter = 0;
+
+static void mutex_demo(char *name)
+{
+	for (int i = 0; i < 100; i++) {
+		mutex_lock(&counter_lock);
+		int c = counter;
+		yield();
+		counter = c + 1;
+		mutex_unlock(&counter_lock);
+	}
+	printf("%s: counter = %d\n", name, counter);
+}
+
+/*
+ * Task 2 passes a buffer to task 3 in a shared memory object, only the
+ * handle is copied.
+ */
+static int shm_handle = -1;
+
+void user_task3(void)
+{
+	while (__atomic_load_n(&shm_handle, __ATOMIC_ACQUIRE) == -1) {
+		futex_wait(&shm_handle, -1);
+	}
+	char *buf = shm_map(shm_handle);
+	if (buf) {
+		printf("Task 3: shm %d of %d bytes: %s", shm_handle,
+		       shm_size(shm_handle), buf);
+		shm_unmap(shm_handle);
+	}
+
+	mutex_demo("Task 3");
+	exit(0);
+}
+#endif
+
+/*
+ * A task which lives for a few ticks, it shows the system calls of the
+ * core set, see syscall.h.
+ */
+void user_task2(void)
+{
+#ifdef CONFIG_SYSCALL
+	char msg[64];
+	int pid = getpid();
+	int n = snprintf(msg, sizeof(msg), "Task 2: Created! pid = %d\n", pid);
+	write(1, msg, n);
+
+	/* the same without an ecall, see vdso.h */
+	n = snprintf(msg, sizeof(msg), "Task 2: vdso: pid = %d, hart = %d, tick = %d\n",
+		     vdso_getpid(), vdso_gethid(), vdso_get_tick(NULL));
+	write(1, msg, n);
+
+	int shm = shm_create(4096);
+	char *shm_buf = shm_map(shm);
+	if (shm_buf) {
+		snprintf(shm_buf, 4096, "hello from task %d\n", pid);
+		__atomic_store_n(&shm_handle, shm, __ATOMIC_RELEASE);
+		futex_wake(&shm_handle, 1);
+	}
+
+	char *buf = malloc(128);
+	for (int i = 0; i < 3 && buf; i++) {
+		uint64_t t;
+		sleep(1);
+		get_time(&t);
+		n = snprintf(buf, 128, "Task 2: woke up at %llu\n", t);
+		write(1, buf, n);
+	}
+	free(buf);
+
+	/* queue a few writes and a timeout, and run them with one ecall */
+	static struct uring ring;
+	static const char *words[] = { "Task 2: ", "batched ", "writes\n" };
+	for (int i = 0; i < 3; i++) {
+		struct uring_sqe *sqe = &ring.sq[ring.sq_tail % URING_ENTRIES];
+		sqe->op = SYS_write;
+		sqe->args[0] = 1;
+		sqe->args[1] = (reg_t)words[i];
+		int len = 0;
+		while (words[i][len]) {
+			len++;
+		}
+		sqe->args[2] = len;
+		sqe->user_data = i;
+		ring.sq_tail++;
+	}
+	struct uring_sqe *sqe = &ring.sq[ring.sq_tail % URING_ENTRIES];
+	sqe->op = URING_OP_TIMEOUT;
+	sqe->args[0] = 1;
+	sqe->user_data = 3;
+	ring.sq_tail++;
+
+	ring_enter(&ring, 4);
+	while (ring.cq_head != ring.cq_tail) {
+		struct uring_cqe *cqe = &ring.cq[ring.cq_head % URING_ENTRIES];
+		n = snprintf(msg, sizeof(msg), "Task 2: entry %d returned %d\n",
+			     cqe->user_data, cqe->res);
+		write(1, msg, n);
+		ring.cq_head++;
+	}
+
+	mutex_demo("Task 2");
+	shm_unmap(shm);
+
+	exit(0);
+#endif
+	while (1) {
+		uart_puts("Task 2: Running... \n");
+		task_delay(DELAY);
+	}
+}
+
+#ifdef CONFIG_UART_BENCH
+extern void uart_bench_start(void);
+#endif
+#ifdef CONFIG_TRAP_BENCH
+extern void trap_bench_start(void);
+#endif
+
 /* NOTICE: DON'T LOOP INFINITELY IN main() */
 void os_main(void)
 {
+#ifdef CONFIG_UART_BENCH
+	uart_bench_start();
+#elif defined(CONFIG_TRAP_BENCH)
+	trap_bench_start();
+#else
 	task_create(user_task0);
 	task_create(user_task1);
+	task_create(user_task2);
+#ifdef CONFIG_SYSCALL
+	task_create(user_task3);
+#endif
+#endif
 }
 
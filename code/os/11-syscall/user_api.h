@@ -1,7 +1,81 @@
 #ifndef __USER_API_H__
 #define __USER_API_H__
 
-/* user mode syscall APIs */
+#include "types.h"
+#include <stddef.h>
+
+/* user mode syscall APIs, see syscall.h */
 extern int gethid(unsigned int *hid);
+extern int read(int fd, char *buf, int n);
+struct perf_stat;
+extern int perf_stat(int task, struct perf_stat *st);
+struct sched_stat;
+extern int sched_stat(int task, struct sched_stat *st);
+extern int write(int fd, const char *buf, int n);
+extern int yield(void);
+/* sleep for ticks of the software timer, ~1s each */
+extern int sleep(unsigned int ticks);
+extern void exit(int status);
+extern int getpid(void);
+/* mtime, in CLINT_TIMEBASE_FREQ */
+extern int get_time(uint64_t *time);
+extern void *malloc(size_t size);
+extern void free(void *ptr);
+/* run the system calls queued in the ring, see struct uring in os.h */
+struct uring;
+extern int ring_enter(struct uring *ring, unsigned int min_complete);
+extern int nop(void);
+/* block while *addr == val, and wake up n tasks blocked on addr */
+extern int futex_wait(int *addr, int val);
+extern int futex_wake(int *addr, int n);
+/* shared memory objects, passed between tasks by handle, see shm.c */
+extern int shm_create(size_t size);
+extern void *shm_map(int handle);
+extern int shm_unmap(int handle);
+extern int shm_size(int handle);
+/* message queues, see mq.c */
+extern int mq_create(unsigned int depth, unsigned int msg_size);
+extern int mq_destroy(int handle);
+extern void *mq_alloc(int handle);
+extern int mq_free(int handle, void *buf);
+extern int mq_send(int handle, void *msg);
+extern void *mq_receive(int handle, void *buf);
+/*
+ * synchronous IPC, the words are passed in registers, see ipc.c.
+ * ipc_call() returns 0 with the reply in msg, and ipc_reply_wait() replies
+ * to client, -1 for none, and returns the client of the next call with
+ * its message in msg. Both return -1 if error occured.
+ */
+struct ipc_msg {
+	reg_t w[6];
+};
+extern int ipc_call(int server, struct ipc_msg *msg);
+extern int ipc_reply_wait(int client, struct ipc_msg *msg);
+/*
+ * pipes, pipe_read() and pipe_write() trap only on the empty and full
+ * edges, see pipe.h and upipe.c
+ */
+struct pipe;
+extern struct pipe *pipe_create(unsigned int size);
+extern int pipe_destroy(struct pipe *p);
+extern int pipe_wait(struct pipe *p, unsigned int side);
+extern int pipe_notify(struct pipe *p, unsigned int side);
+extern int pipe_read(struct pipe *p, char *buf, int n);
+extern int pipe_write(struct pipe *p, const char *buf, int n);
+/*
+ * wait till one of the objects is ready or timeout ticks pass, see WAIT_*
+ * in os.h. It returns a bit for each ready handle, 0 on timeout.
+ */
+extern int wait_any(const int *handles, int n, int timeout);
+
+/* user-space mutex, see mutex.c */
+struct mutex {
+	int state;
+};
+#define MUTEX_INITIALIZER { 0 }
+extern void mutex_init(struct mutex *m);
+extern int mutex_trylock(struct mutex *m);
+extern void mutex_lock(struct mutex *m);
+extern void mutex_unlock(struct mutex *m);
 
 #endif /* __USER_API_H__ */
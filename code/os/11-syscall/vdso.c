@@ -0,0 +1,49 @@
+#include "os.h"
+
+/*
+ * The vDSO data page.
+ *
+ * There is no MMU, so the page is not mapped but shared: it is a page of
+ * the kernel, which PMP makes read-only to the user mode, see start.S.
+ */
+union vdso_page __attribute__((aligned(VDSO_PAGE_SIZE))) vdso_page;
+
+/* these routines should be called in interrupt context (interrupt is disabled) */
+static inline void vdso_write_begin(void)
+{
+	vdso_data.seq++;
+	__sync_synchronize();
+}
+
+static inline void vdso_write_end(void)
+{
+	__sync_synchronize();
+	vdso_data.seq++;
+}
+
+void vdso_update_tick(uint32_t tick, uint64_t mtime)
+{
+	vdso_write_begin();
+	vdso_data.tick = tick;
+	vdso_data.mtime_base = mtime;
+	vdso_write_end();
+}
+
+void vdso_update_task(int task)
+{
+	vdso_write_begin();
+	vdso_data.task = task;
+	vdso_write_end();
+}
+
+void vdso_init(void)
+{
+	vdso_write_begin();
+	vdso_data.timebase_freq = CLINT_TIMEBASE_FREQ;
+	vdso_data.hartid = r_mhartid();
+	vdso_data.task = -1;
+	vdso_write_end();
+
+	/* allow rdcycle, rdtime and rdinstret in the user mode */
+	w_csr(mcounteren, 0x7);
+}
@@ -0,0 +1,95 @@
+#ifndef __VDSO_H__
+#define __VDSO_H__
+
+#include "types.h"
+
+/*
+ * The vDSO data page, which the kernel keeps up to date and the user tasks
+ * can read, but not write, see vdso.c.
+ *
+ * The kernel updates it in interrupt context, so a task may be interrupted
+ * while reading it. seq is odd while the kernel is updating it, and bumped
+ * again when done, the readers retry if seq is odd or changes under them.
+ */
+struct vdso_data {
+	volatile uint32_t seq;
+	volatile uint32_t tick;		/* ticks of the software timer */
+	volatile uint64_t mtime_base;	/* mtime at the last tick */
+	volatile uint32_t timebase_freq;
+	volatile uint32_t hartid;
+	volatile int task;		/* the running task */
+};
+
+/*
+ * Nothing else may share the page, as it is read-only to the user mode, so
+ * the data takes a whole page.
+ */
+#define VDSO_PAGE_SIZE 4096
+union vdso_page {
+	struct vdso_data data;
+	uint8_t page[VDSO_PAGE_SIZE];
+};
+extern union vdso_page vdso_page;
+#define vdso_data (vdso_page.data)
+
+static inline uint32_t vdso_read_begin(void)
+{
+	uint32_t seq;
+	while ((seq = vdso_data.seq) & 1)
+		;
+	__sync_synchronize();
+	return seq;
+}
+
+static inline int vdso_read_retry(uint32_t seq)
+{
+	__sync_synchronize();
+	return vdso_data.seq != seq;
+}
+
+/*
+ * The user helpers, each costs a few loads rather than an ecall.
+ */
+static inline uint32_t vdso_get_tick(uint64_t *mtime_base)
+{
+	uint32_t seq, tick;
+	uint64_t base;
+	do {
+		seq = vdso_read_begin();
+		tick = vdso_data.tick;
+		base = vdso_data.mtime_base;
+	} while (vdso_read_retry(seq));
+
+	if (mtime_base) {
+		*mtime_base = base;
+	}
+	return tick;
+}
+
+static inline int vdso_gethid(void)
+{
+	return vdso_data.hartid;
+}
+
+static inline int vdso_getpid(void)
+{
+	return vdso_data.task;
+}
+
+/*
+ * mtime by rdtime, the kernel allows it in the user mode through
+ * mcounteren. On RV32 it takes two reads, so read the high word again to
+ * make sure the low word didn't wrap in between.
+ */
+static inline uint64_t vdso_get_time(void)
+{
+	uint32_t hi, lo, hi2;
+	do {
+		asm volatile("rdtimeh %0" : "=r" (hi));
+		asm volatile("rdtime %0" : "=r" (lo));
+		asm volatile("rdtimeh %0" : "=r" (hi2));
+	} while (hi != hi2);
+	return ((uint64_t)hi << 32) | lo;
+}
+
+#endif /* __VDSO_H__ */
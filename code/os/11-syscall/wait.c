@@ -0,0 +1,126 @@
+#include "os.h"
+
+/*
+ * Waiting on several objects at once.
+ *
+ * wait_any() puts the calling task on the wait queue of each object it
+ * waits on, and on its own queue for the timeout, so whichever of them is
+ * woken up first makes the task ready. It waits by restarting, like
+ * syscall_wait(): when the task runs again the system call checks all the
+ * objects again, and takes the task off the queues which didn't wake it.
+ * The timer of the timeout is kept across the restarts, and waiting tells
+ * that the task is in the middle of a wait_any().
+ */
+static struct wait_queue timeouts[MAX_TASKS];
+static struct timer *wait_timer[MAX_TASKS];
+static uint8_t waiting[MAX_TASKS];
+static uint8_t timed_out[MAX_TASKS];
+
+static void wait_timeout(void *arg)
+{
+	int id = (int)(reg_t)arg;
+
+	wait_timer[id] = NULL;
+	timed_out[id] = 1;
+	wake_up(&timeouts[id]);
+}
+
+/* 1 if the object is ready, 0 if not, -1 if the handle is invalid */
+static int wait_poll(int handle, struct wait_queue **wq)
+{
+	int id = handle & WAIT_ID_MASK;
+
+	switch (handle >> WAIT_TYPE_SHIFT) {
+	case WAIT_TYPE_MQ:
+		return mq_poll(id, wq);
+	case WAIT_TYPE_PIPE:
+		return pipe_poll(id, wq);
+	case WAIT_TYPE_TTY:
+		*wq = tty_wait_queue();
+		return tty_poll();
+	default:
+		return -1;
+	}
+}
+
+/* undo what wait_poll() left behind once the task doesn't wait any more */
+static void wait_cancel(int handle)
+{
+	if ((handle >> WAIT_TYPE_SHIFT) == WAIT_TYPE_PIPE) {
+		pipe_poll_cancel(handle & WAIT_ID_MASK);
+	}
+}
+
+/*
+ * DESCRIPTION
+ * 	Block till one of the objects is ready, or the timeout passes.
+ * 	- handles: n handles, WAIT_MQ(), WAIT_PIPE() or WAIT_TTY
+ * 	- n: 1 ~ WAIT_MAX
+ * 	- timeout: in ticks, 0 to return at once, WAIT_FOREVER for no timeout
+ * RETURN VALUE
+ * 	a bit for each handle which is ready, 0 if the timeout passed
+ * 	-1: if error occured
+ */
+int sys_wait_any(const int *handles, int n, int timeout)
+{
+	int id = task_current();
+	struct wait_queue *wqs[WAIT_MAX];
+	int ret = 0;
+	int err = 0;
+
+	if (handles == NULL || n <= 0 || n > WAIT_MAX ||
+	    (timeout < 0 && timeout != WAIT_FOREVER)) {
+		return -1;
+	}
+
+	for (int i = 0; i < n; i++) {
+		int r = wait_poll(handles[i], &wqs[i]);
+		if (r < 0) {
+			/* e.g. destroyed while waited on, check the rest still */
+			err = 1;
+			continue;
+		}
+		if (r) {
+			ret |= 1 << i;
+		}
+		/* woken up by another one or not waited yet */
+		wait_queue_remove(wqs[i]);
+	}
+	if (err) {
+		ret = -1;
+		goto out;
+	}
+	if (ret || timeout == 0 || timed_out[id]) {
+		goto out;
+	}
+
+	if (!waiting[id]) {
+		waiting[id] = 1;
+		if (timeout > 0) {
+			wait_timer[id] = timer_create(wait_timeout, (void *)(reg_t)id,
+						      timeout);
+			if (wait_timer[id] == NULL) {
+				ret = -1;
+				goto out;
+			}
+		}
+	}
+
+	for (int i = 0; i < n; i++) {
+		wait_queue_sleep(wqs[i]);
+	}
+	syscall_wait(&timeouts[id]);
+
+out:
+	for (int i = 0; i < n; i++) {
+		wait_cancel(handles[i]);
+	}
+	if (wait_timer[id]) {
+		timer_delete(wait_timer[id]);
+		wait_timer[id] = NULL;
+	}
+	wait_queue_remove(&timeouts[id]);
+	waiting[id] = 0;
+	timed_out[id] = 0;
+	return ret;
+}
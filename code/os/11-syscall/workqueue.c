@@ -0,0 +1,152 @@
+#include "os.h"
+
+/*
+ * Work queues are the bottom halves of the interrupt handlers.
+ * An interrupt handler only acknowledges its device and queues a work item,
+ * the slow part (e.g. writing to the UART) is done later by a kernel task
+ * (kworker) with interrupts enabled. This bounds the time the CPU spends
+ * with interrupts disabled.
+ *
+ * Each work queue is a FIFO list of work items served by its own kworker.
+ * A work item can only be on one queue once, queuing it again before it has
+ * been run is a no-op.
+ */
+struct workqueue {
+	struct work *head;
+	struct work *tail;
+	struct wait_queue wait;
+	int used;
+};
+
+#define MAX_WORKQUEUES 2
+static struct workqueue wq_list[MAX_WORKQUEUES];
+
+/* the default work queue used by queue_work() */
+static struct workqueue *system_wq = NULL;
+
+static struct work *workqueue_get(struct workqueue *wq)
+{
+	struct work *w = wq->head;
+	if (NULL != w) {
+		wq->head = w->next;
+		if (NULL == wq->head) {
+			wq->tail = NULL;
+		}
+		w->next = NULL;
+		w->pending = 0;
+	}
+	return w;
+}
+
+static void worker_loop(struct workqueue *wq)
+{
+	while (1) {
+		spin_lock();
+		struct work *w = workqueue_get(wq);
+		if (NULL == w) {
+			/* nothing to do, sleep till some work is queued */
+			wait_queue_sleep(&wq->wait);
+			task_yield();
+			spin_unlock();
+			continue;
+		}
+		spin_unlock();
+
+		/* run the work with interrupt enabled */
+		w->func(w->arg);
+	}
+}
+
+/*
+ * Kernel tasks have no argument, so each work queue slot has its own
+ * worker entry.
+ */
+static void kworker0(void)
+{
+	worker_loop(&wq_list[0]);
+}
+
+static void kworker1(void)
+{
+	worker_loop(&wq_list[1]);
+}
+
+static void (*kworkers[MAX_WORKQUEUES])(void) = { kworker0, kworker1 };
+
+/*
+ * DESCRIPTION
+ * 	Create a work queue served by a new kernel task.
+ * RETURN VALUE
+ * 	pointer of the work queue: success
+ * 	NULL: if error occured
+ */
+struct workqueue *workqueue_create(void)
+{
+	for (int i = 0; i < MAX_WORKQUEUES; i++) {
+		struct workqueue *wq = &wq_list[i];
+		if (wq->used) {
+			continue;
+		}
+		if (ktask_create(kworkers[i]) < 0) {
+			return NULL;
+		}
+		wq->head = NULL;
+		wq->tail = NULL;
+		wq->wait.tasks = 0;
+		wq->used = 1;
+		return wq;
+	}
+	return NULL;
+}
+
+void workqueue_init(void)
+{
+	system_wq = workqueue_create();
+	if (NULL == system_wq) {
+		panic("failed to create the system work queue!");
+	}
+}
+
+void work_init(struct work *w, void (*func)(void *arg), void *arg)
+{
+	w->func = func;
+	w->arg = arg;
+	w->next = NULL;
+	w->pending = 0;
+}
+
+/*
+ * DESCRIPTION
+ * 	Queue a work item on the given work queue and wake up its kworker.
+ * 	Can be called in interrupt context or by kernel tasks.
+ * RETURN VALUE
+ * 	0: success
+ * 	-1: if the work is pending already
+ */
+int queue_work_on(struct workqueue *wq, struct work *w)
+{
+	reg_t flags = local_irq_save();
+
+	if (w->pending) {
+		local_irq_restore(flags);
+		return -1;
+	}
+	w->pending = 1;
+	w->next = NULL;
+	if (NULL == wq->tail) {
+		wq->head = w;
+	} else {
+		wq->tail->next = w;
+	}
+	wq->tail = w;
+
+	wake_up(&wq->wait);
+
+	local_irq_restore(flags);
+	return 0;
+}
+
+int queue_work(struct work *w)
+{
+	return queue_work_on(system_wq, w);
+}